@@ -0,0 +1,463 @@
+/*
+  This file is part of the MKRGSM library.
+  Copyright (C) 2017  Arduino AG (http://www.arduino.cc/)
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <algorithm>
+
+#include "SaraEmulator.h"
+
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+static std::string toHex(const std::string& data)
+{
+  std::string hex;
+
+  for (size_t i = 0; i < data.length(); i++) {
+    hex += HEX_DIGITS[(uint8_t)data[i] >> 4];
+    hex += HEX_DIGITS[(uint8_t)data[i] & 0x0f];
+  }
+
+  return hex;
+}
+
+static std::string fromHex(const std::string& hex)
+{
+  std::string data;
+
+  for (size_t i = 0; i + 1 < hex.length(); i += 2) {
+    data += (char)strtol(hex.substr(i, 2).c_str(), NULL, 16);
+  }
+
+  return data;
+}
+
+// the comma separated arguments after the '=', without quotes
+static std::vector<std::string> arguments(const std::string& line)
+{
+  std::vector<std::string> result;
+  size_t equals = line.find('=');
+
+  if (equals == std::string::npos) {
+    return result;
+  }
+
+  std::string argument;
+  bool quoted = false;
+
+  for (size_t i = equals + 1; i < line.length(); i++) {
+    char c = line[i];
+
+    if (c == '"') {
+      quoted = !quoted;
+    } else if (c == ',' && !quoted) {
+      result.push_back(argument);
+      argument = "";
+    } else {
+      argument += c;
+    }
+  }
+
+  result.push_back(argument);
+
+  return result;
+}
+
+static std::string ok(const std::string& information = "")
+{
+  if (information.empty()) {
+    return "\r\nOK\r\n";
+  }
+
+  return "\r\n" + information + "\r\n\r\nOK\r\n";
+}
+
+static const char ERROR_RESPONSE[] = "\r\nERROR\r\n";
+
+SaraEmulator::SaraEmulator() :
+  _baud(115200),
+  _latency(5000),
+  _hexMode(false),
+  _commandCount(0),
+  _binarySocket(-1),
+  _binaryRemaining(0),
+  _rxLast(0),
+  _smsIndex(1)
+{
+  for (int i = 0; i < SARA_EMULATOR_SOCKETS; i++) {
+    _sockets[i].used = false;
+    _sockets[i].connected = false;
+    _sockets[i].closed = false;
+  }
+}
+
+void SaraEmulator::begin(unsigned long baud)
+{
+  _baud = baud;
+}
+
+void SaraEmulator::begin(unsigned long baud, uint16_t)
+{
+  begin(baud);
+}
+
+void SaraEmulator::end()
+{
+}
+
+int SaraEmulator::available()
+{
+  if (_rx.empty()) {
+    return 0;
+  }
+
+  uint64_t now = hostMicros();
+
+  if (_rx.front().first > now) {
+    // like millis(), every look at the UART takes a little time, so a
+    // loop polling for a response gets there
+    hostAdvance(1);
+    now++;
+  }
+
+  // the bytes are queued in the order they are due
+  std::deque<std::pair<uint64_t, uint8_t> >::const_iterator due =
+    std::upper_bound(_rx.begin(), _rx.end(), std::make_pair(now, (uint8_t)0xff));
+  int count = due - _rx.begin();
+
+  // like the SAMD core's ring buffer, report at most SERIAL_BUFFER_SIZE
+  // bytes, the rest arrives while those are read
+  if (count > SERIAL_BUFFER_SIZE) {
+    count = SERIAL_BUFFER_SIZE;
+  }
+
+  return count;
+}
+
+int SaraEmulator::read()
+{
+  if (available() == 0) {
+    return -1;
+  }
+
+  uint8_t c = _rx.front().second;
+
+  _rx.pop_front();
+
+  return c;
+}
+
+int SaraEmulator::peek()
+{
+  if (available() == 0) {
+    return -1;
+  }
+
+  return _rx.front().second;
+}
+
+void SaraEmulator::flush()
+{
+}
+
+size_t SaraEmulator::write(uint8_t c)
+{
+  hostAdvance(byteTime());
+
+  _transmitted += (char)c;
+
+  if (_binaryRemaining) {
+    if (c == '\n' && _binaryData.empty() && _transmitted[_transmitted.length() - 2] == '\r') {
+      // the rest of the command line's \r\n, not payload yet
+      return 1;
+    }
+
+    // payload after the @ prompt of AT+USOWR
+    _binaryData += (char)c;
+
+    if (--_binaryRemaining == 0) {
+      char information[32];
+
+      _sockets[_binarySocket].received += _binaryData;
+      sprintf(information, "+USOWR: %d,%d", _binarySocket, (int)_binaryData.length());
+      emit("\r\n" + std::string(information) + "\r\n\r\nOK\r\n", _latency);
+
+      _binarySocket = -1;
+      _binaryData = "";
+    }
+
+    return 1;
+  }
+
+  if (c == '\r') {
+    if (!_line.empty()) {
+      command(_line);
+      _line = "";
+    }
+  } else if (c != '\n') {
+    _line += (char)c;
+  }
+
+  return 1;
+}
+
+void SaraEmulator::setLatency(unsigned long latency)
+{
+  _latency = latency;
+}
+
+void SaraEmulator::on(const char* prefix, const char* response)
+{
+  _scripted.push_back(std::make_pair(std::string(prefix), std::string(response)));
+}
+
+void SaraEmulator::peerSend(int socket, const uint8_t* data, size_t length)
+{
+  char urc[32];
+
+  _sockets[socket].pending.append((const char*)data, length);
+
+  sprintf(urc, "+UUSORD: %d,%d", socket, (int)_sockets[socket].pending.length());
+  unsolicited(urc);
+}
+
+void SaraEmulator::peerSend(int socket, const char* data)
+{
+  peerSend(socket, (const uint8_t*)data, strlen(data));
+}
+
+void SaraEmulator::peerClose(int socket)
+{
+  char urc[32];
+
+  _sockets[socket].closed = true;
+
+  sprintf(urc, "+UUSOCL: %d", socket);
+  unsolicited(urc);
+}
+
+const std::string& SaraEmulator::peerReceived(int socket)
+{
+  return _sockets[socket].received;
+}
+
+void SaraEmulator::unsolicited(const char* line)
+{
+  emit("\r\n" + std::string(line) + "\r\n", 0);
+}
+
+void SaraEmulator::addSms(const char* from, const char* text)
+{
+  _sms[_smsIndex++] = std::make_pair(std::string(from), std::string(text));
+}
+
+const std::string& SaraEmulator::transmitted()
+{
+  return _transmitted;
+}
+
+unsigned long SaraEmulator::commands(const char* prefix)
+{
+  return _commands[prefix];
+}
+
+unsigned long SaraEmulator::commands()
+{
+  return _commandCount;
+}
+
+void SaraEmulator::reset()
+{
+  _transmitted = "";
+  _commands.clear();
+  _commandCount = 0;
+}
+
+void SaraEmulator::emit(const std::string& data, unsigned long latency)
+{
+  uint64_t due = hostMicros() + latency;
+
+  if (due < _rxLast) {
+    // the UART sends one byte after the other
+    due = _rxLast;
+  }
+
+  for (size_t i = 0; i < data.length(); i++) {
+    due += byteTime();
+    _rx.push_back(std::make_pair(due, (uint8_t)data[i]));
+  }
+
+  _rxLast = due;
+}
+
+void SaraEmulator::command(const std::string& line)
+{
+  std::string name = line.substr(0, line.find_first_of("=?"));
+
+  _commands[name]++;
+  _commandCount++;
+
+  // echo
+  emit(line + "\r", 0);
+
+  for (size_t i = 0; i < _scripted.size(); i++) {
+    if (line.compare(0, _scripted[i].first.length(), _scripted[i].first) == 0) {
+      emit(_scripted[i].second, _latency);
+      _scripted.erase(_scripted.begin() + i);
+      return;
+    }
+  }
+
+  std::vector<std::string> args = arguments(line);
+
+  if (name == "AT+USOWR" && args.size() == 2) {
+    // binary write, the payload follows the prompt
+    int socket = atoi(args[0].c_str());
+
+    if (socket < 0 || socket >= SARA_EMULATOR_SOCKETS || !_sockets[socket].used) {
+      emit(ERROR_RESPONSE, _latency);
+      return;
+    }
+
+    _binarySocket = socket;
+    _binaryRemaining = atoi(args[1].c_str());
+    emit("\r\n@", _latency);
+    return;
+  }
+
+  emit(respond(line), _latency);
+}
+
+std::string SaraEmulator::respond(const std::string& line)
+{
+  std::string name = line.substr(0, line.find_first_of("=?"));
+  std::vector<std::string> args = arguments(line);
+  char information[64];
+
+  if (name == "AT+CPIN") {
+    return ok("+CPIN: READY");
+  } else if (name == "AT+CREG") {
+    return ok("+CREG: 0,1");
+  } else if (name == "AT+CGMR") {
+    return ok("08.90");
+  } else if (name == "AT+CCLK") {
+    return ok("+CCLK: \"26/10/17,12:00:00+00\"");
+  } else if (name == "AT+UDCONF" && args.size() == 2 && args[0] == "1") {
+    _hexMode = (args[1] == "1");
+  } else if (name == "AT+UPSND") {
+    if (args.size() == 2 && args[1] == "0") {
+      return ok("+UPSND: 0,0,\"10.0.0.2\"");
+    }
+
+    return ok("+UPSND: 0,8,1");
+  } else if (name == "AT+UDNSRN") {
+    return ok("+UDNSRN: \"93.184.216.34\"");
+  } else if (name == "AT+USOCR") {
+    for (int i = 0; i < SARA_EMULATOR_SOCKETS; i++) {
+      if (!_sockets[i].used) {
+        _sockets[i].used = true;
+        _sockets[i].connected = false;
+        _sockets[i].closed = false;
+        _sockets[i].pending = "";
+        _sockets[i].received = "";
+
+        sprintf(information, "+USOCR: %d", i);
+        return ok(information);
+      }
+    }
+
+    return ERROR_RESPONSE;
+  } else if (name == "AT+USOCO" || name == "AT+USOLI" || name == "AT+USOCL" || name == "AT+USOWR" ||
+             name == "AT+USORD" || name == "AT+USOST" || name == "AT+USORF" || name == "AT+USOSEC") {
+    int socket = args.empty() ? -1 : atoi(args[0].c_str());
+
+    if (socket < 0 || socket >= SARA_EMULATOR_SOCKETS || !_sockets[socket].used) {
+      return ERROR_RESPONSE;
+    }
+
+    Socket& s = _sockets[socket];
+
+    if (name == "AT+USOCO") {
+      s.connected = true;
+    } else if (name == "AT+USOCL") {
+      s.used = false;
+    } else if (name == "AT+USOWR" && args.size() == 3) {
+      std::string data = _hexMode ? fromHex(args[2]) : args[2];
+
+      s.received += data;
+      sprintf(information, "+USOWR: %d,%d", socket, (int)data.length());
+      return ok(information);
+    } else if (name == "AT+USOST" && args.size() == 5) {
+      std::string data = _hexMode ? fromHex(args[4]) : args[4];
+
+      s.received += data;
+      sprintf(information, "+USOST: %d,%d", socket, (int)data.length());
+      return ok(information);
+    } else if (name == "AT+USORD" && args.size() == 2) {
+      size_t length = atoi(args[1].c_str());
+
+      if (length == 0) {
+        // how much is waiting
+        sprintf(information, "+USORD: %d,%d", socket, (int)s.pending.length());
+        return ok(information);
+      }
+
+      if (length > 1024) {
+        return ERROR_RESPONSE;
+      }
+
+      std::string data = s.pending.substr(0, length);
+
+      s.pending.erase(0, data.length());
+      sprintf(information, "+USORD: %d,%d,\"", socket, (int)data.length());
+      return ok(information + (_hexMode ? toHex(data) : data) + "\"");
+    } else if (name == "AT+USORF" && args.size() == 2) {
+      size_t length = atoi(args[1].c_str());
+      std::string data = s.pending.substr(0, length);
+
+      s.pending.erase(0, data.length());
+      sprintf(information, "+USORF: %d,\"10.0.0.1\",7,%d,\"", socket, (int)data.length());
+      return ok(information + (_hexMode ? toHex(data) : data) + "\"");
+    }
+  } else if (name == "AT+CMGL") {
+    std::string list;
+
+    for (std::map<int, std::pair<std::string, std::string> >::const_iterator i = _sms.begin(); i != _sms.end(); ++i) {
+      sprintf(information, "+CMGL: %d,\"REC UNREAD\",\"", i->first);
+
+      if (!list.empty()) {
+        list += "\r\n";
+      }
+      list += information + i->second.first + "\",,\"26/10/17,12:00:00+00\"\r\n" + i->second.second;
+    }
+
+    return ok(list);
+  } else if (name == "AT+CMGD" && !args.empty()) {
+    _sms.erase(atoi(args[0].c_str()));
+  }
+
+  return ok();
+}
+
+uint64_t SaraEmulator::byteTime()
+{
+  // 8N1, ten bits per byte
+  return (10000000UL + _baud - 1) / _baud;
+}
+
+SaraEmulator SerialGSMEmulator;
+Uart& SerialGSM = SerialGSMEmulator;
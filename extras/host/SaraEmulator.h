@@ -0,0 +1,117 @@
+/*
+  This file is part of the MKRGSM library.
+  Copyright (C) 2017  Arduino AG (http://www.arduino.cc/)
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _SARA_EMULATOR_H_INCLUDED
+#define _SARA_EMULATOR_H_INCLUDED
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+
+#define SARA_EMULATOR_SOCKETS 7
+
+// SerialGSM on the host: answers the AT commands the library uses the way a
+// SARA-U201 does, with a simulated clock paced by the baud rate and a fixed
+// response latency
+class SaraEmulator : public Uart {
+public:
+  SaraEmulator();
+
+  // HardwareSerial
+  void begin(unsigned long baud);
+  void begin(unsigned long baud, uint16_t config);
+  void end();
+  int available();
+  int read();
+  int peek();
+  void flush();
+  size_t write(uint8_t c);
+  using Print::write;
+  operator bool() { return true; }
+
+  // time between the end of a command and the start of its response, in us
+  void setLatency(unsigned long latency);
+
+  // the next command starting with prefix gets response (everything after
+  // the echo, including the final result code) instead of the built in one
+  void on(const char* prefix, const char* response);
+
+  // bytes the remote end sends to / receives from a socket, as +UUSORD announces
+  void peerSend(int socket, const uint8_t* data, size_t length);
+  void peerSend(int socket, const char* data);
+  void peerClose(int socket);
+  const std::string& peerReceived(int socket);
+
+  // a URC or other unsolicited line (without the trailing \r\n)
+  void unsolicited(const char* line);
+
+  // SMS messages AT+CMGL lists
+  void addSms(const char* from, const char* text);
+
+  // everything the library wrote, and how often a command was sent
+  const std::string& transmitted();
+  unsigned long commands(const char* prefix);
+  unsigned long commands();
+  void reset();
+
+private:
+  struct Socket {
+    bool used;
+    bool connected;
+    bool closed;
+    std::string pending;
+    std::string received;
+  };
+
+  void emit(const std::string& data, unsigned long latency);
+  void command(const std::string& line);
+  std::string respond(const std::string& line);
+  std::string usord(int socket, size_t length);
+  int socketArgument(const std::string& arguments);
+  uint64_t byteTime();
+
+  unsigned long _baud;
+  unsigned long _latency;
+  bool _hexMode;
+
+  std::string _line;
+  std::string _transmitted;
+  std::map<std::string, unsigned long> _commands;
+  unsigned long _commandCount;
+
+  int _binarySocket;
+  size_t _binaryRemaining;
+  std::string _binaryData;
+
+  std::deque<std::pair<uint64_t, uint8_t> > _rx;
+  uint64_t _rxLast;
+
+  std::vector<std::pair<std::string, std::string> > _scripted;
+  std::map<int, std::pair<std::string, std::string> > _sms;
+  int _smsIndex;
+
+  Socket _sockets[SARA_EMULATOR_SOCKETS];
+};
+
+extern SaraEmulator SerialGSMEmulator;
+
+#endif
@@ -0,0 +1,40 @@
+/*
+  This file is part of the MKRGSM library.
+  Copyright (C) 2017  Arduino AG (http://www.arduino.cc/)
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef _BENCHMARK_H_INCLUDED
+#define _BENCHMARK_H_INCLUDED
+
+#include <chrono>
+
+#include <Arduino.h>
+
+#include "SaraEmulator.h"
+
+// host CPU time, for the parts of the library that are compute bound
+static inline uint64_t cpuMicros()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// simulated time in ms, for the parts that wait for the modem
+static inline double modemMillis()
+{
+  return hostMicros() / 1000.0;
+}
+
+#endif
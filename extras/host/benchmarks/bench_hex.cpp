@@ -0,0 +1,134 @@
+/*
+  This file is part of the MKRGSM library.
+  Copyright (C) 2017  Arduino AG (http://www.arduino.cc/)
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+// Encodes and decodes socket payloads with GSMHex and with the per character
+// loops GSMClient::write and GSMSocketBuffer::available used before it
+
+#include <stdio.h>
+
+#include "utility/GSMHex.h"
+
+#include "Benchmark.h"
+
+static const size_t chunk = 256;
+static const size_t total = 1024 * 1024;
+
+static void legacyEncode(const uint8_t* buf, size_t size, String& command)
+{
+  for (size_t i = 0; i < size; i++) {
+    byte b = buf[i];
+
+    byte n1 = (b >> 4) & 0x0f;
+    byte n2 = (b & 0x0f);
+
+    command += (char)(n1 > 9 ? 'A' + n1 - 10 : '0' + n1);
+    command += (char)(n2 > 9 ? 'A' + n2 - 10 : '0' + n2);
+  }
+}
+
+static void legacyDecode(const String& response, uint8_t* data)
+{
+  size_t size = response.length() / 2;
+
+  for (size_t i = 0; i < size; i++) {
+    byte n1 = response[i * 2];
+    byte n2 = response[i * 2 + 1];
+
+    if (n1 > '9') {
+      n1 = (n1 - 'A') + 10;
+    } else {
+      n1 = (n1 - '0');
+    }
+
+    if (n2 > '9') {
+      n2 = (n2 - 'A') + 10;
+    } else {
+      n2 = (n2 - '0');
+    }
+
+    data[i] = (n1 << 4) | n2;
+  }
+}
+
+static void report(const char* name, uint64_t elapsed)
+{
+  printf("%-16s %8.1f MB/s\n", name, total / (double)elapsed);
+}
+
+int main()
+{
+  uint8_t data[chunk];
+  uint8_t decoded[chunk];
+  String hex;
+  unsigned long check = 0;
+
+  for (size_t i = 0; i < chunk; i++) {
+    data[i] = i * 37;
+  }
+
+  hex.reserve(chunk * 2);
+
+  uint64_t start = cpuMicros();
+
+  for (size_t n = 0; n < total; n += chunk) {
+    hex = "";
+    legacyEncode(data, chunk, hex);
+    check += hex[n % (chunk * 2)];
+  }
+
+  report("encode, legacy", cpuMicros() - start);
+
+  start = cpuMicros();
+
+  for (size_t n = 0; n < total; n += chunk) {
+    hex = "";
+    GSMHex::encode(data, chunk, hex);
+    check += hex[n % (chunk * 2)];
+  }
+
+  report("encode, GSMHex", cpuMicros() - start);
+
+  start = cpuMicros();
+
+  for (size_t n = 0; n < total; n += chunk) {
+    legacyDecode(hex, decoded);
+    check += decoded[n % chunk];
+  }
+
+  report("decode, legacy", cpuMicros() - start);
+
+  start = cpuMicros();
+
+  for (size_t n = 0; n < total; n += chunk) {
+    if (GSMHex::decode(hex.c_str(), hex.length(), decoded) != (int)chunk) {
+      printf("decode failed\n");
+      return 1;
+    }
+    check += decoded[n % chunk];
+  }
+
+  report("decode, GSMHex", cpuMicros() - start);
+
+  if (memcmp(data, decoded, chunk) != 0) {
+    printf("round trip failed\n");
+    return 1;
+  }
+
+  // keeps the loops from being optimized away
+  return check == 0;
+}
@@ -0,0 +1,99 @@
+/*
+  This file is part of the MKRGSM library.
+  Copyright (C) 2017  Arduino AG (http://www.arduino.cc/)
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+// Sends an HTTP GET request assembled with print()/println() the way the
+// examples do, straight through and with a coalescing write buffer
+
+#include <stdio.h>
+
+#include "GSMClient.h"
+#include "Modem.h"
+
+#include "Benchmark.h"
+
+static size_t request(GSMClient& client)
+{
+  size_t length = 0;
+
+  length += client.print("GET ");
+  length += client.print("/asciilogo.txt");
+  length += client.println(" HTTP/1.1");
+  length += client.print("Host: ");
+  length += client.println("arduino.tips");
+  length += client.println("User-Agent: MKRGSM");
+  length += client.println("Connection: close");
+  length += client.println();
+
+  return length;
+}
+
+static int run(const char* name, uint8_t* buffer, size_t size, unsigned long maxDelay)
+{
+  SaraEmulator& modem = SerialGSMEmulator;
+  GSMClient client;
+
+  if (!client.connect(IPAddress(10, 0, 0, 1), 80)) {
+    printf("connect failed\n");
+    return 0;
+  }
+
+  // the previous run closed its socket
+  const int socket = 0;
+
+  client.setWriteBuffer(buffer, size, maxDelay);
+  modem.reset();
+
+  double start = modemMillis();
+  size_t length = request(client);
+  double printed = modemMillis();
+
+  while (modem.peerReceived(socket).length() < length) {
+    MODEM.poll();
+
+    if (modemMillis() - start > 10000) {
+      printf("%s: request not sent\n", name);
+      return 0;
+    }
+  }
+
+  printf("%-30s %2lu AT+USOWR, %6.1f ms in print(), sent after %6.1f ms\n", name, modem.commands("AT+USOWR"), printed - start, modemMillis() - start);
+
+  client.stop();
+
+  return 1;
+}
+
+int main()
+{
+  static uint8_t buffer[256];
+
+  if (!MODEM.begin(false)) {
+    printf("modem did not answer\n");
+    return 1;
+  }
+
+  MODEM.send("AT+UDCONF=1,1");
+  MODEM.waitForResponse();
+
+  if (!run("unbuffered", NULL, 0, 0) ||
+      !run("setWriteBuffer(buf, 256, 50)", buffer, sizeof(buffer), 50)) {
+    return 1;
+  }
+
+  return 0;
+}
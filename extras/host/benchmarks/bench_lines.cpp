@@ -0,0 +1,105 @@
+/*
+  This file is part of the MKRGSM library.
+  Copyright (C) 2017  Arduino AG (http://www.arduino.cc/)
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+// Parses long responses, the worst cases for the line parser: one long line
+// of hex characters (AT+URDFILE) and many short lines (AT+CMGL)
+
+#include <stdio.h>
+#include <string>
+
+#include "Modem.h"
+
+#include "Benchmark.h"
+
+static const int runs = 10;
+
+static int run(const char* name, const char* command, const std::string& information)
+{
+  std::string response = "\r\n" + information + "\r\n\r\nOK\r\n";
+  uint64_t total = 0;
+  uint64_t best = (uint64_t)-1;
+
+  for (int i = 0; i < runs; i++) {
+    String data;
+
+    SerialGSMEmulator.on(command, response.c_str());
+    MODEM.send(command);
+
+    // the whole response is in the UART before the parse is timed
+    hostAdvance(10000000);
+
+    uint64_t start = cpuMicros();
+
+    if (MODEM.waitForResponse(100, &data) != 1 || data.length() != information.length()) {
+      printf("%s: response not parsed\n", name);
+      return 0;
+    }
+
+    uint64_t elapsed = cpuMicros() - start;
+
+    total += elapsed;
+    if (elapsed < best) {
+      best = elapsed;
+    }
+  }
+
+  printf("%-28s %8.1f us average, %8.1f us best\n", name, (double)total / runs, (double)best);
+
+  return 1;
+}
+
+int main()
+{
+  if (!MODEM.begin(false)) {
+    printf("modem did not answer\n");
+    return 1;
+  }
+
+  static const size_t sizes[] = { 1024, 16384, 65536 };
+
+  for (unsigned int i = 0; i < (sizeof(sizes) / sizeof(sizes[0])); i++) {
+    char name[32];
+
+    sprintf(name, "%u byte hex line", (unsigned int)sizes[i]);
+    if (!run(name, "AT+URDFILE=\"bench\"", "+URDFILE: \"bench\"," + std::to_string(sizes[i]) + ",\"" + std::string(sizes[i] * 2, 'A') + "\"")) {
+      return 1;
+    }
+  }
+
+  static const int counts[] = { 10, 100, 500 };
+
+  for (unsigned int i = 0; i < (sizeof(counts) / sizeof(counts[0])); i++) {
+    std::string list;
+    char name[32];
+
+    for (int j = 1; j <= counts[i]; j++) {
+      if (j > 1) {
+        list += "\r\n";
+      }
+      list += "+CMGL: " + std::to_string(j) + ",\"REC READ\",\"+15555550100\",,\"26/10/17,12:00:00+00\"\r\n";
+      list += "Message " + std::to_string(j) + " of the benchmark listing";
+    }
+
+    sprintf(name, "%d message SMS list", counts[i]);
+    if (!run(name, "AT+CMGL=\"ALL\"", list)) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
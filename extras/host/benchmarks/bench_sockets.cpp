@@ -0,0 +1,108 @@
+/*
+  This file is part of the MKRGSM library.
+  Copyright (C) 2017  Arduino AG (http://www.arduino.cc/)
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+// Reads data that arrived on several sockets at once. The sketch spends some
+// time on every chunk it reads and polls the modem every ms meanwhile, so
+// read ahead can overlap with it
+
+#include <stdio.h>
+
+#include "GSMClient.h"
+#include "Modem.h"
+
+#include "Benchmark.h"
+
+#define SOCKETS 4
+#define PAYLOAD 4096
+
+// sketch time spent on every chunk read, in ms
+static unsigned long work = 2;
+
+int main(int argc, char** argv)
+{
+  SaraEmulator& modem = SerialGSMEmulator;
+  GSMClient clients[SOCKETS];
+  uint8_t payload[PAYLOAD];
+  size_t received[SOCKETS] = { 0 };
+  size_t total = 0;
+
+  if (argc > 1) {
+    work = atol(argv[1]);
+  }
+
+  if (!MODEM.begin(false)) {
+    printf("modem did not answer\n");
+    return 1;
+  }
+
+  MODEM.send("AT+UDCONF=1,1");
+  MODEM.waitForResponse();
+
+  for (int i = 0; i < SOCKETS; i++) {
+    if (!clients[i].connect(IPAddress(10, 0, 0, 1), 80 + i)) {
+      printf("connect %d failed\n", i);
+      return 1;
+    }
+  }
+
+  for (size_t i = 0; i < PAYLOAD; i++) {
+    payload[i] = i;
+  }
+
+  for (int i = 0; i < SOCKETS; i++) {
+    modem.peerSend(i, payload, PAYLOAD);
+  }
+
+  modem.reset();
+
+  double start = modemMillis();
+
+  while (total < SOCKETS * PAYLOAD) {
+    for (int i = 0; i < SOCKETS; i++) {
+      uint8_t buf[512];
+
+      if (clients[i].available()) {
+        int n = clients[i].read(buf, sizeof(buf));
+
+        if (n > 0) {
+          if (memcmp(buf, payload + received[i], n) != 0) {
+            printf("socket %d: wrong data\n", i);
+            return 1;
+          }
+
+          received[i] += n;
+          total += n;
+
+          for (unsigned long ms = 0; ms < work; ms++) {
+            delay(1);
+            MODEM.poll();
+          }
+        }
+      }
+    }
+
+    if (modemMillis() - start > 60000) {
+      printf("timed out with %u bytes\n", (unsigned int)total);
+      return 1;
+    }
+  }
+
+  printf("%d sockets x %d bytes: %8.1f ms, %lu AT+USORD\n", SOCKETS, PAYLOAD, modemMillis() - start, modem.commands("AT+USORD"));
+
+  return 0;
+}
@@ -0,0 +1,85 @@
+/*
+  This file is part of the MKRGSM library.
+  Copyright (C) 2017  Arduino AG (http://www.arduino.cc/)
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+// Dispatches a stream of URCs with the handlers a sketch using 7 TCP
+// sockets, a UDP socket, a server, GPRS and voice calls registers
+
+#include <stdio.h>
+
+#include "GPRS.h"
+#include "GSMClient.h"
+#include "GSMServer.h"
+#include "GSMUdp.h"
+#include "GSMVoiceCall.h"
+#include "Modem.h"
+
+#include "Benchmark.h"
+
+#define URCS 20000
+
+static const int runs = 5;
+
+static void run(const char* name, const char* urc)
+{
+  uint64_t best = (uint64_t)-1;
+
+  for (int i = 0; i < runs; i++) {
+    for (int j = 0; j < URCS; j++) {
+      SerialGSMEmulator.unsolicited(urc);
+    }
+
+    // the whole stream is in the UART before the dispatch is timed
+    hostAdvance(10000000);
+
+    uint64_t start = cpuMicros();
+
+    while (SerialGSM.available()) {
+      MODEM.poll();
+    }
+
+    uint64_t elapsed = cpuMicros() - start;
+
+    if (elapsed < best) {
+      best = elapsed;
+    }
+  }
+
+  printf("%-24s %6.0f ns per URC\n", name, best * 1000.0 / URCS);
+}
+
+int main()
+{
+  GPRS gprs;
+  GSMVoiceCall voice;
+  GSMClient clients[7];
+  GSMUDP udp;
+  GSMServer server(80);
+
+  if (!MODEM.begin(false)) {
+    printf("modem did not answer\n");
+    return 1;
+  }
+
+  // nobody handles it
+  run("+CIEV (unhandled)", "+CIEV: 2,3");
+
+  // socket buffers, the server and UDP handle it
+  run("+UUSOCL (handled)", "+UUSOCL: 6");
+
+  return 0;
+}
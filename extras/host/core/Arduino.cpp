@@ -0,0 +1,343 @@
+/*
+  This file is part of the MKRGSM library.
+  Copyright (C) 2017  Arduino AG (http://www.arduino.cc/)
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <ctype.h>
+
+#include "Arduino.h"
+
+static uint64_t clockMicros = 0;
+
+uint64_t hostMicros()
+{
+  return clockMicros;
+}
+
+void hostAdvance(uint64_t us)
+{
+  clockMicros += us;
+}
+
+unsigned long millis()
+{
+  // every look at the clock takes a little time, so loops that spin
+  // until a timeout terminate without the emulator having to step in
+  clockMicros++;
+
+  return clockMicros / 1000;
+}
+
+unsigned long micros()
+{
+  clockMicros++;
+
+  return clockMicros;
+}
+
+void delay(unsigned long ms)
+{
+  clockMicros += (uint64_t)ms * 1000;
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  clockMicros += us;
+}
+
+void yield()
+{
+}
+
+void pinMode(int, int)
+{
+}
+
+void digitalWrite(int, int)
+{
+}
+
+static std::string toString(unsigned long value, unsigned char base, bool negative)
+{
+  std::string s;
+
+  do {
+    int digit = value % base;
+
+    s.insert(s.begin(), (char)(digit < 10 ? '0' + digit : 'A' + digit - 10));
+    value /= base;
+  } while (value);
+
+  if (negative) {
+    s.insert(s.begin(), '-');
+  }
+
+  return s;
+}
+
+String::String(const char* s) : _s(s == NULL ? "" : s) {}
+String::String(const String& s) : _s(s._s) {}
+String::String(char c) : _s(1, c) {}
+String::String(int value, unsigned char base) : _s(toString(value < 0 && base == 10 ? -(long)value : (unsigned int)value, base, value < 0 && base == 10)) {}
+String::String(unsigned int value, unsigned char base) : _s(toString(value, base, false)) {}
+String::String(long value, unsigned char base) : _s(toString(value < 0 && base == 10 ? -value : (unsigned long)value, base, value < 0 && base == 10)) {}
+String::String(unsigned long value, unsigned char base) : _s(toString(value, base, false)) {}
+
+String::String(float value, unsigned char decimalPlaces)
+{
+  char buffer[64];
+
+  snprintf(buffer, sizeof(buffer), "%.*f", decimalPlaces, value);
+  _s = buffer;
+}
+
+String::~String() {}
+
+String& String::operator=(const String& s) { _s = s._s; return *this; }
+String& String::operator=(const char* s) { _s = (s == NULL ? "" : s); return *this; }
+
+unsigned char String::reserve(unsigned int size) { _s.reserve(size); return 1; }
+unsigned int String::length() const { return _s.length(); }
+const char* String::c_str() const { return _s.c_str(); }
+
+String& String::operator+=(const String& s) { _s += s._s; return *this; }
+String& String::operator+=(const char* s) { if (s != NULL) _s += s; return *this; }
+String& String::operator+=(char c) { _s += c; return *this; }
+String& String::operator+=(unsigned char value) { return *this += String((unsigned int)value); }
+String& String::operator+=(int value) { return *this += String(value); }
+String& String::operator+=(unsigned int value) { return *this += String(value); }
+String& String::operator+=(long value) { return *this += String(value); }
+String& String::operator+=(unsigned long value) { return *this += String(value); }
+unsigned char String::concat(const char* s) { *this += s; return 1; }
+
+unsigned char String::startsWith(const String& prefix) const { return startsWith(prefix, 0); }
+
+unsigned char String::startsWith(const String& prefix, unsigned int offset) const
+{
+  return offset + prefix._s.length() <= _s.length() && _s.compare(offset, prefix._s.length(), prefix._s) == 0;
+}
+
+unsigned char String::endsWith(const String& suffix) const
+{
+  return suffix._s.length() <= _s.length() && _s.compare(_s.length() - suffix._s.length(), suffix._s.length(), suffix._s) == 0;
+}
+
+unsigned char String::equals(const String& s) const { return _s == s._s; }
+unsigned char String::equals(const char* s) const { return _s == (s == NULL ? "" : s); }
+unsigned char String::operator==(const String& s) const { return equals(s); }
+unsigned char String::operator==(const char* s) const { return equals(s); }
+unsigned char String::operator!=(const char* s) const { return !equals(s); }
+
+char String::charAt(unsigned int index) const { return index < _s.length() ? _s[index] : 0; }
+void String::setCharAt(unsigned int index, char c) { if (index < _s.length()) _s[index] = c; }
+char String::operator[](unsigned int index) const { return charAt(index); }
+char& String::operator[](unsigned int index) { return _s[index]; }
+
+static int position(size_t p) { return p == std::string::npos ? -1 : (int)p; }
+
+int String::indexOf(char c) const { return position(_s.find(c)); }
+int String::indexOf(char c, unsigned int from) const { return position(_s.find(c, from)); }
+int String::indexOf(const String& s) const { return position(_s.find(s._s)); }
+int String::indexOf(const String& s, unsigned int from) const { return position(_s.find(s._s, from)); }
+int String::lastIndexOf(char c) const { return position(_s.rfind(c)); }
+int String::lastIndexOf(const String& s) const { return position(_s.rfind(s._s)); }
+
+String String::substring(unsigned int begin) const { return substring(begin, _s.length()); }
+
+String String::substring(unsigned int begin, unsigned int end) const
+{
+  if (begin > end) {
+    unsigned int t = begin;
+
+    begin = end;
+    end = t;
+  }
+
+  if (begin >= _s.length()) {
+    return String();
+  }
+
+  if (end > _s.length()) {
+    end = _s.length();
+  }
+
+  return String(_s.substr(begin, end - begin).c_str());
+}
+
+void String::remove(unsigned int index) { if (index < _s.length()) _s.erase(index); }
+void String::remove(unsigned int index, unsigned int count) { if (index < _s.length()) _s.erase(index, count); }
+
+void String::trim()
+{
+  size_t begin = 0;
+  size_t end = _s.length();
+
+  while (begin < end && isspace((unsigned char)_s[begin])) {
+    begin++;
+  }
+
+  while (end > begin && isspace((unsigned char)_s[end - 1])) {
+    end--;
+  }
+
+  _s = _s.substr(begin, end - begin);
+}
+
+void String::toUpperCase()
+{
+  for (size_t i = 0; i < _s.length(); i++) {
+    _s[i] = toupper((unsigned char)_s[i]);
+  }
+}
+
+void String::replace(const String& find, const String& replace)
+{
+  if (find._s.empty()) {
+    return;
+  }
+
+  for (size_t p = 0; (p = _s.find(find._s, p)) != std::string::npos; p += replace._s.length()) {
+    _s.replace(p, find._s.length(), replace._s);
+  }
+}
+
+long String::toInt() const { return atol(_s.c_str()); }
+float String::toFloat() const { return atof(_s.c_str()); }
+
+void String::toCharArray(char* buffer, unsigned int size, unsigned int index) const
+{
+  getBytes((unsigned char*)buffer, size, index);
+}
+
+void String::getBytes(unsigned char* buffer, unsigned int size, unsigned int index) const
+{
+  if (size == 0) {
+    return;
+  }
+
+  size_t n = index < _s.length() ? _s.length() - index : 0;
+
+  if (n > size - 1) {
+    n = size - 1;
+  }
+
+  memcpy(buffer, _s.c_str() + (index < _s.length() ? index : 0), n);
+  buffer[n] = '\0';
+}
+
+String operator+(const String& a, const String& b)
+{
+  String s(a);
+
+  s += b;
+  return s;
+}
+
+String operator+(const String& a, const char* b)
+{
+  String s(a);
+
+  s += b;
+  return s;
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size)
+{
+  size_t n = 0;
+
+  while (size--) {
+    if (write(*buffer++) == 0) {
+      break;
+    }
+    n++;
+  }
+
+  return n;
+}
+
+size_t Print::printNumber(unsigned long value, int base)
+{
+  return print(String(value, base));
+}
+
+size_t Print::print(const String& s) { return write((const uint8_t*)s.c_str(), s.length()); }
+size_t Print::print(const char* s) { return write(s); }
+size_t Print::print(char c) { return write((uint8_t)c); }
+size_t Print::print(unsigned char value, int base) { return printNumber(value, base); }
+size_t Print::print(int value, int base) { return print((long)value, base); }
+size_t Print::print(unsigned int value, int base) { return printNumber(value, base); }
+
+size_t Print::print(long value, int base)
+{
+  if (value < 0 && base == 10) {
+    return print('-') + printNumber(-value, base);
+  }
+
+  return printNumber(value, base);
+}
+
+size_t Print::print(unsigned long value, int base) { return printNumber(value, base); }
+size_t Print::print(double value, int digits) { return print(String((float)value, digits)); }
+
+size_t Print::println(const String& s) { return print(s) + println(); }
+size_t Print::println(const char* s) { return print(s) + println(); }
+size_t Print::println(char c) { return print(c) + println(); }
+size_t Print::println(unsigned char value, int base) { return print(value, base) + println(); }
+size_t Print::println(int value, int base) { return print(value, base) + println(); }
+size_t Print::println(unsigned int value, int base) { return print(value, base) + println(); }
+size_t Print::println(long value, int base) { return print(value, base) + println(); }
+size_t Print::println(unsigned long value, int base) { return print(value, base) + println(); }
+size_t Print::println(double value, int digits) { return print(value, digits) + println(); }
+size_t Print::println() { return write("\r\n"); }
+
+IPAddress::IPAddress() { memset(_address, 0, sizeof(_address)); }
+
+IPAddress::IPAddress(uint32_t address) { memcpy(_address, &address, sizeof(_address)); }
+
+IPAddress::IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+{
+  _address[0] = a;
+  _address[1] = b;
+  _address[2] = c;
+  _address[3] = d;
+}
+
+IPAddress::IPAddress(const uint8_t* address) { memcpy(_address, address, sizeof(_address)); }
+
+bool IPAddress::fromString(const char* address)
+{
+  unsigned int a, b, c, d;
+
+  if (sscanf(address, "%u.%u.%u.%u", &a, &b, &c, &d) != 4 || a > 255 || b > 255 || c > 255 || d > 255) {
+    return false;
+  }
+
+  *this = IPAddress(a, b, c, d);
+  return true;
+}
+
+bool IPAddress::fromString(const String& address) { return fromString(address.c_str()); }
+
+IPAddress::operator uint32_t() const
+{
+  uint32_t address;
+
+  memcpy(&address, _address, sizeof(address));
+  return address;
+}
+
+HostSerial Serial;
@@ -0,0 +1,236 @@
+/*
+  This file is part of the MKRGSM library.
+  Copyright (C) 2017  Arduino AG (http://www.arduino.cc/)
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+// The subset of the Arduino core the library uses, for building it on a
+// host. Time is simulated: it only moves when the code waits, so runs
+// against the modem emulator are deterministic.
+
+#ifndef _HOST_ARDUINO_H_INCLUDED
+#define _HOST_ARDUINO_H_INCLUDED
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+
+#define DEC 10
+#define HEX 16
+
+// the board variant pins, no reset or DTR line on the host
+#define GSM_RESETN (-1)
+#define GSM_DTR (-1)
+
+// the SAMD core's UART receive ring
+#define SERIAL_BUFFER_SIZE 350
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+
+/** Simulated clock, in microseconds since start */
+uint64_t hostMicros();
+void hostAdvance(uint64_t us);
+
+class String {
+public:
+  String(const char* s = "");
+  String(const String& s);
+  explicit String(char c);
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(float value, unsigned char decimalPlaces = 2);
+  ~String();
+
+  String& operator=(const String& s);
+  String& operator=(const char* s);
+
+  unsigned char reserve(unsigned int size);
+  unsigned int length() const;
+  const char* c_str() const;
+
+  String& operator+=(const String& s);
+  String& operator+=(const char* s);
+  String& operator+=(char c);
+  String& operator+=(unsigned char value);
+  String& operator+=(int value);
+  String& operator+=(unsigned int value);
+  String& operator+=(long value);
+  String& operator+=(unsigned long value);
+  unsigned char concat(const char* s);
+
+  unsigned char startsWith(const String& prefix) const;
+  unsigned char startsWith(const String& prefix, unsigned int offset) const;
+  unsigned char endsWith(const String& suffix) const;
+  unsigned char equals(const String& s) const;
+  unsigned char equals(const char* s) const;
+  unsigned char operator==(const String& s) const;
+  unsigned char operator==(const char* s) const;
+  unsigned char operator!=(const char* s) const;
+
+  char charAt(unsigned int index) const;
+  void setCharAt(unsigned int index, char c);
+  char operator[](unsigned int index) const;
+  char& operator[](unsigned int index);
+
+  int indexOf(char c) const;
+  int indexOf(char c, unsigned int from) const;
+  int indexOf(const String& s) const;
+  int indexOf(const String& s, unsigned int from) const;
+  int lastIndexOf(char c) const;
+  int lastIndexOf(const String& s) const;
+
+  String substring(unsigned int begin) const;
+  String substring(unsigned int begin, unsigned int end) const;
+  void remove(unsigned int index);
+  void remove(unsigned int index, unsigned int count);
+  void trim();
+  void toUpperCase();
+  void replace(const String& find, const String& replace);
+
+  long toInt() const;
+  float toFloat() const;
+  void toCharArray(char* buffer, unsigned int size, unsigned int index = 0) const;
+  void getBytes(unsigned char* buffer, unsigned int size, unsigned int index = 0) const;
+
+private:
+  std::string _s;
+};
+
+String operator+(const String& a, const String& b);
+String operator+(const String& a, const char* b);
+
+class Print {
+public:
+  Print() : _writeError(0) {}
+  virtual ~Print() {}
+
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size);
+  size_t write(const char* s) { return s == NULL ? 0 : write((const uint8_t*)s, strlen(s)); }
+  size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+  virtual int availableForWrite() { return 0; }
+  virtual void flush() {}
+
+  int getWriteError() { return _writeError; }
+  void clearWriteError() { _writeError = 0; }
+
+  size_t print(const String& s);
+  size_t print(const char* s);
+  size_t print(char c);
+  size_t print(unsigned char value, int base = DEC);
+  size_t print(int value, int base = DEC);
+  size_t print(unsigned int value, int base = DEC);
+  size_t print(long value, int base = DEC);
+  size_t print(unsigned long value, int base = DEC);
+  size_t print(double value, int digits = 2);
+
+  size_t println(const String& s);
+  size_t println(const char* s);
+  size_t println(char c);
+  size_t println(unsigned char value, int base = DEC);
+  size_t println(int value, int base = DEC);
+  size_t println(unsigned int value, int base = DEC);
+  size_t println(long value, int base = DEC);
+  size_t println(unsigned long value, int base = DEC);
+  size_t println(double value, int digits = 2);
+  size_t println();
+
+protected:
+  void setWriteError(int error = 1) { _writeError = error; }
+
+private:
+  size_t printNumber(unsigned long value, int base);
+
+  int _writeError;
+};
+
+class Stream : public Print {
+public:
+  Stream() : _timeout(1000) {}
+
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long timeout) { _timeout = timeout; }
+
+protected:
+  unsigned long _timeout;
+};
+
+class HardwareSerial : public Stream {
+public:
+  virtual void begin(unsigned long baud) = 0;
+  virtual void begin(unsigned long baud, uint16_t config) = 0;
+  virtual void end() = 0;
+  virtual int available() = 0;
+  virtual int peek() = 0;
+  virtual int read() = 0;
+  virtual void flush() = 0;
+  virtual size_t write(uint8_t c) = 0;
+  using Print::write;
+  virtual operator bool() = 0;
+};
+
+// the SAMD core class SerialGSM is an instance of
+class Uart : public HardwareSerial {
+};
+
+// Serial prints to stdout
+class HostSerial : public Uart {
+public:
+  void begin(unsigned long) {}
+  void begin(unsigned long, uint16_t) {}
+  void end() {}
+  int available() { return 0; }
+  int peek() { return -1; }
+  int read() { return -1; }
+  void flush() { fflush(stdout); }
+  size_t write(uint8_t c) { return fputc(c, stdout) == EOF ? 0 : 1; }
+  using Print::write;
+  operator bool() { return true; }
+};
+
+extern HostSerial Serial;
+
+// provided by the modem emulator
+extern Uart& SerialGSM;
+
+#include "IPAddress.h"
+
+#endif
@@ -0,0 +1,46 @@
+/*
+  This file is part of the MKRGSM library.
+  Copyright (C) 2017  Arduino AG (http://www.arduino.cc/)
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _HOST_IPADDRESS_H_INCLUDED
+#define _HOST_IPADDRESS_H_INCLUDED
+
+#include <stdint.h>
+
+class String;
+
+class IPAddress {
+public:
+  IPAddress();
+  IPAddress(uint32_t address);
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d);
+  IPAddress(const uint8_t* address);
+
+  bool fromString(const char* address);
+  bool fromString(const String& address);
+
+  uint8_t operator[](int index) const { return _address[index]; }
+  uint8_t& operator[](int index) { return _address[index]; }
+  operator uint32_t() const;
+  bool operator==(const IPAddress& other) const { return (uint32_t)*this == (uint32_t)other; }
+
+private:
+  uint8_t _address[4];
+};
+
+#endif
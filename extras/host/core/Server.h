@@ -0,0 +1,13 @@
+// Server.h of the host Arduino core
+
+#ifndef _HOST_SERVER_H_INCLUDED
+#define _HOST_SERVER_H_INCLUDED
+
+#include "Arduino.h"
+
+class Server : public Print {
+public:
+  virtual void begin() = 0;
+};
+
+#endif
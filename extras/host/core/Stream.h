@@ -0,0 +1,3 @@
+// Stream.h of the host Arduino core, Stream lives in Arduino.h
+
+#include "Arduino.h"
@@ -17,41 +17,22 @@
   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
+#include "utility/ModemThread.h"
+
 #include "GPRS.h"
 
-enum {
-  GPRS_STATE_IDLE,
-  GPRS_STATE_ATTACH,
-  GPRS_STATE_WAIT_ATTACH_RESPONSE,
-  GPRS_STATE_SET_APN,
-  GPRS_STATE_WAIT_SET_APN_RESPONSE,
-  GPRS_STATE_SET_AUTH_MODE,
-  GPRS_STATE_WAIT_SET_AUTH_MODE_RESPONSE,
-  GPRS_STATE_SET_USERNAME,
-  GPRS_STATE_WAIT_SET_USERNAME_RESPONSE,
-  GPRS_STATE_SET_PASSWORD,
-  GPRS_STATE_WAIT_SET_PASSWORD_RESPONSE,
-  GPRS_STATE_SET_DYNAMIC_IP,
-  GPRS_STATE_WAIT_SET_DYNAMIC_IP_RESPONSE,
-  GPRS_STATE_ACTIVATE_IP,
-  GPRS_STATE_WAIT_ACTIVATE_IP_RESPONSE,
-  GPRS_STATE_CHECK_PROFILE_STATUS,
-  GPRS_STATE_WAIT_CHECK_PROFILE_STATUS_RESPONSE,
-
-  GPRS_STATE_DEACTIVATE_IP,
-  GPRS_STATE_WAIT_DEACTIVATE_IP_RESPONSE,
-  GPRS_STATE_DEATTACH,
-  GPRS_STATE_WAIT_DEATTACH_RESPONSE
-};
+static const char* const URC_PREFIXES[] = { "+UUPINGER", "+UUPING", "+UUPSDD", NULL };
 
 GPRS::GPRS() :
   _apn(NULL),
   _username(NULL),
   _password(NULL),
+  _readyState(MODEM_THREAD_DONE),
+  _attach(false),
   _status(IDLE),
   _timeout(0)
 {
-  MODEM.addUrcHandler(this);
+  MODEM.addUrcHandler(this, URC_PREFIXES);
 }
 
 GPRS::~GPRS()
@@ -65,7 +46,8 @@ GSM3_NetworkStatus_t GPRS::attachGPRS(const char* apn, const char* user_name, co
   _username = user_name;
   _password = password;
 
-  _state = GPRS_STATE_ATTACH;
+  _readyState = MODEM_THREAD_START;
+  _attach = true;
   _status = CONNECTING;
 
   if (synchronous) {
@@ -73,11 +55,11 @@ GSM3_NetworkStatus_t GPRS::attachGPRS(const char* apn, const char* user_name, co
 
     while (ready() == 0) {
       if (_timeout && !((millis() - start) < _timeout)) {
-        _state = ERROR;
+        _readyState = MODEM_THREAD_DONE;
         break;
       }
 
-      delay(100);
+      MODEM.idle(100);
     }
   } else {
     ready();
@@ -88,11 +70,12 @@ GSM3_NetworkStatus_t GPRS::attachGPRS(const char* apn, const char* user_name, co
 
 GSM3_NetworkStatus_t GPRS::detachGPRS(bool synchronous)
 {
-  _state = GPRS_STATE_DEACTIVATE_IP;
+  _readyState = MODEM_THREAD_START;
+  _attach = false;
 
   if (synchronous) {
     while (ready() == 0) {
-      delay(100);
+      MODEM.idle(100);
     }
   } else {
     ready();
@@ -109,193 +92,97 @@ int GPRS::ready()
     return 0;
   }
 
-  switch (_state) {
-    case GPRS_STATE_IDLE:
-    default: {
-      break;
-    }
+  // every wait returns 0 and resumes here once the modem has a result in ready,
+  // attachGPRS() and detachGPRS() start the thread over
+  MODEM_THREAD_BEGIN(_readyState);
 
-    case GPRS_STATE_ATTACH: {
-      MODEM.send("AT+CGATT=1");
-      _state = GPRS_STATE_WAIT_ATTACH_RESPONSE;
-      ready = 0;
-      break;
-    }
+  if (_attach) {
+    MODEM.send("AT+CGATT=1");
+    MODEM_THREAD_YIELD(_readyState, 0);
 
-    case GPRS_STATE_WAIT_ATTACH_RESPONSE: {
-      if (ready > 1) {
-        _state = GPRS_STATE_IDLE;
-        _status = ERROR;
-      } else {
-        _state = GPRS_STATE_SET_APN;
-        ready = 0;
-      }
-      break;
-    }
-    case GPRS_STATE_SET_APN: {
-      MODEM.sendf("AT+UPSD=0,1,\"%s\"", _apn);
-      _state = GPRS_STATE_WAIT_SET_APN_RESPONSE;
-      ready = 0;
-      break;
+    if (ready > 1) {
+      _status = ERROR;
+      MODEM_THREAD_EXIT(_readyState, ready);
     }
 
-    case GPRS_STATE_WAIT_SET_APN_RESPONSE: {
-      if (ready > 1) {
-        _state = GPRS_STATE_IDLE;
-        _status = ERROR;
-      } else {
-        _state = GPRS_STATE_SET_AUTH_MODE;
-        ready = 0;
-      }
-      break;
-    }
+    MODEM.sendf("AT+UPSD=0,1,\"%s\"", _apn);
+    MODEM_THREAD_YIELD(_readyState, 0);
 
-    case GPRS_STATE_SET_AUTH_MODE: {
-       MODEM.sendf("AT+UPSD=0,6,3");
-      _state = GPRS_STATE_WAIT_SET_AUTH_MODE_RESPONSE;
-      ready = 0;
-      break;
+    if (ready > 1) {
+      _status = ERROR;
+      MODEM_THREAD_EXIT(_readyState, ready);
     }
 
-    case GPRS_STATE_WAIT_SET_AUTH_MODE_RESPONSE: {
-      if (ready > 1) {
-        _state = GPRS_STATE_IDLE;
-        _status = ERROR;
-      } else {
-        _state = GPRS_STATE_SET_USERNAME;
-        ready = 0;
-      }
-      break;
-    }
+    MODEM.sendf("AT+UPSD=0,6,3");
+    MODEM_THREAD_YIELD(_readyState, 0);
 
-    case GPRS_STATE_SET_USERNAME: {
-      MODEM.sendf("AT+UPSD=0,2,\"%s\"", _username);
-      _state = GPRS_STATE_WAIT_SET_USERNAME_RESPONSE;
-      ready = 0;
-      break;
+    if (ready > 1) {
+      _status = ERROR;
+      MODEM_THREAD_EXIT(_readyState, ready);
     }
 
-    case GPRS_STATE_WAIT_SET_USERNAME_RESPONSE: {
-      if (ready > 1) {
-        _state = GPRS_STATE_IDLE;
-        _status = ERROR;
-      } else {
-        _state = GPRS_STATE_SET_PASSWORD;
-        ready = 0;
-      }
-      break;
-    }
+    MODEM.sendf("AT+UPSD=0,2,\"%s\"", _username);
+    MODEM_THREAD_YIELD(_readyState, 0);
 
-    case GPRS_STATE_SET_PASSWORD: {
-      MODEM.sendf("AT+UPSD=0,3,\"%s\"", _password);
-      _state = GPRS_STATE_WAIT_SET_PASSWORD_RESPONSE;
-      ready = 0;
-      break;
+    if (ready > 1) {
+      _status = ERROR;
+      MODEM_THREAD_EXIT(_readyState, ready);
     }
 
-    case GPRS_STATE_WAIT_SET_PASSWORD_RESPONSE: {
-      if (ready > 1) {
-        _state = GPRS_STATE_IDLE;
-        _status = ERROR;
-      } else {
-        _state = GPRS_STATE_SET_DYNAMIC_IP;
-        ready = 0;
-      }
-      break;
-    }
+    MODEM.sendf("AT+UPSD=0,3,\"%s\"", _password);
+    MODEM_THREAD_YIELD(_readyState, 0);
 
-    case GPRS_STATE_SET_DYNAMIC_IP: {
-      MODEM.send("AT+UPSD=0,7,\"0.0.0.0\"");
-      _state = GPRS_STATE_WAIT_SET_DYNAMIC_IP_RESPONSE;
-      ready = 0;
-      break;
+    if (ready > 1) {
+      _status = ERROR;
+      MODEM_THREAD_EXIT(_readyState, ready);
     }
 
-    case GPRS_STATE_WAIT_SET_DYNAMIC_IP_RESPONSE: {
-      if (ready > 1) {
-        _state = GPRS_STATE_IDLE;
-        _status = ERROR;
-      } else {
-        _state = GPRS_STATE_ACTIVATE_IP;
-        ready = 0;
-      }
-      break;
-    }
+    MODEM.send("AT+UPSD=0,7,\"0.0.0.0\"");
+    MODEM_THREAD_YIELD(_readyState, 0);
 
-    case GPRS_STATE_ACTIVATE_IP: {
-      MODEM.send("AT+UPSDA=0,3");
-      _state = GPRS_STATE_WAIT_ACTIVATE_IP_RESPONSE;
-      ready = 0;
-      break;
+    if (ready > 1) {
+      _status = ERROR;
+      MODEM_THREAD_EXIT(_readyState, ready);
     }
 
-    case GPRS_STATE_WAIT_ACTIVATE_IP_RESPONSE: {
-      if (ready > 1) {
-        _state = GPRS_STATE_IDLE;
-        _status = ERROR;
-      } else {
-        _state = GPRS_STATE_CHECK_PROFILE_STATUS;
-        ready = 0;
-      }
-      break;
-    }
+    MODEM.send("AT+UPSDA=0,3");
+    MODEM_THREAD_YIELD(_readyState, 0);
 
-    case GPRS_STATE_CHECK_PROFILE_STATUS: {
-      MODEM.setResponseDataStorage(&_response);
-      MODEM.send("AT+UPSND=0,8");
-      _state = GPRS_STATE_WAIT_CHECK_PROFILE_STATUS_RESPONSE;
-      ready = 0;
-      break;
-    }
-    
-    case GPRS_STATE_WAIT_CHECK_PROFILE_STATUS_RESPONSE: {
-      if (ready > 1 || !_response.endsWith(",1")) {
-        _state = GPRS_STATE_IDLE;
-        _status = ERROR;
-      } else {
-        _state = GPRS_STATE_IDLE;
-        _status = GPRS_READY;
-      }
-      break;
+    if (ready > 1) {
+      _status = ERROR;
+      MODEM_THREAD_EXIT(_readyState, ready);
     }
 
-    case GPRS_STATE_DEACTIVATE_IP: {
-      MODEM.send("AT+UPSDA=0,4");
-      _state = GPRS_STATE_WAIT_DEACTIVATE_IP_RESPONSE;
-      ready = 0;
-      break;
-    }
+    MODEM.setResponseDataStorage(&_response);
+    MODEM.send("AT+UPSND=0,8");
+    MODEM_THREAD_YIELD(_readyState, 0);
 
-    case GPRS_STATE_WAIT_DEACTIVATE_IP_RESPONSE: {
-      if (ready > 1) {
-        _state = GPRS_STATE_IDLE;
-        _status = ERROR;
-      } else {
-        _state = GPRS_STATE_DEATTACH;
-        ready = 0;
-      }
-      break;
+    if (ready > 1 || !_response.endsWith(",1")) {
+      _status = ERROR;
+    } else {
+      _status = GPRS_READY;
     }
+  } else {
+    MODEM.send("AT+UPSDA=0,4");
+    MODEM_THREAD_YIELD(_readyState, 0);
 
-    case GPRS_STATE_DEATTACH: {
-      MODEM.send("AT+CGATT=0");
-      _state = GPRS_STATE_WAIT_DEATTACH_RESPONSE;
-      ready = 0;
-      break;
+    if (ready > 1) {
+      _status = ERROR;
+      MODEM_THREAD_EXIT(_readyState, ready);
     }
 
-    case GPRS_STATE_WAIT_DEATTACH_RESPONSE: {
-      if (ready > 1) {
-        _state = GPRS_STATE_IDLE;
-        _status = ERROR;
-      } else {
-        _state = GPRS_STATE_IDLE;
-        _status = IDLE;
-      }
-      break;
+    MODEM.send("AT+CGATT=0");
+    MODEM_THREAD_YIELD(_readyState, 0);
+
+    if (ready > 1) {
+      _status = ERROR;
+    } else {
+      _status = IDLE;
     }
   }
 
+  MODEM_THREAD_END(_readyState);
+
   return ready;
 }
 
@@ -398,21 +285,19 @@ GSM3_NetworkStatus_t GPRS::status()
   return _status;
 }
 
-void GPRS::handleUrc(const String& urc)
+void GPRS::handleUrc(const ModemLine& urc)
 {
-  if (urc.startsWith("+UUPINGER: ")) {
-    if (urc.endsWith(",8")) {
+  if (urc.is("+UUPINGER")) {
+    if (urc.fieldInt(urc.fields() - 1) == 8) {
       _pingResult = GPRS_PING_UNKNOWN_HOST;
     } else {
       _pingResult = GPRS_PING_ERROR;
     }
-  } else if (urc.startsWith("+UUPING: ")) {
-    int lastCommaIndex = urc.lastIndexOf(',');
-
-    if (lastCommaIndex == -1) {
+  } else if (urc.is("+UUPING")) {
+    if (urc.fields() < 2) {
       _pingResult = GPRS_PING_ERROR;
     } else {
-      _pingResult = urc.substring(lastCommaIndex + 1).toInt();
+      _pingResult = urc.fieldInt(urc.fields() - 1);
 
       if (_pingResult == -1) {
         _pingResult = GPRS_PING_TIMEOUT;
@@ -420,8 +305,8 @@ void GPRS::handleUrc(const String& urc)
         _pingResult = GPRS_PING_ERROR;
       }
     }
-  } else if (urc.startsWith("+UUPSDD: ")) {
-    int profileId = urc.charAt(urc.length() - 1) - '0';
+  } else if (urc.is("+UUPSDD")) {
+    int profileId = urc.fieldInt(0);
 
     if (profileId == 0) {
       // disconnected
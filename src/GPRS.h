@@ -91,13 +91,14 @@ public:
 
   GSM3_NetworkStatus_t status();
 
-  void handleUrc(const String& urc);
+  void handleUrc(const ModemLine& urc);
 
 private:
   const char* _apn;
   const char* _username;
   const char* _password;
-  int _state;
+  int _readyState;
+  bool _attach;
   GSM3_NetworkStatus_t _status;
   String _response;
   int _pingResult;
@@ -21,29 +21,10 @@
 #include <time.h>
 
 #include "Modem.h"
+#include "utility/ModemThread.h"
 
 #include "GSM.h"
 
-enum {
-  READY_STATE_CHECK_SIM,
-  READY_STATE_WAIT_CHECK_SIM_RESPONSE,
-  READY_STATE_UNLOCK_SIM,
-  READY_STATE_WAIT_UNLOCK_SIM_RESPONSE,
-  READY_STATE_SET_PREFERRED_MESSAGE_FORMAT,
-  READY_STATE_WAIT_SET_PREFERRED_MESSAGE_FORMAT_RESPONSE,
-  READY_STATE_SET_HEX_MODE,
-  READY_STATE_WAIT_SET_HEX_MODE,
-  READY_STATE_SET_AUTOMATIC_TIME_ZONE,
-  READY_STATE_WAIT_SET_AUTOMATIC_TIME_ZONE_RESPONSE,
-  READY_STATE_ENABLE_DTMF_DETECTION,
-  READY_STATE_WAIT_ENABLE_DTMF_DETECTION_RESPONSE,
-  READY_STATE_CHECK_REGISTRATION,
-  READY_STATE_WAIT_CHECK_REGISTRATION_RESPONSE,
-  READY_STATE_SET_REPORTING_CALL_STATUS,
-  READY_STATE_WAIT_SET_REPORTING_CALL_STATUS,
-  READY_STATE_DONE
-};
-
 GSM::GSM(bool debug) :
   _state(ERROR),
   _readyState(0),
@@ -62,7 +43,7 @@ GSM3_NetworkStatus_t GSM::begin(const char* pin, bool restart, bool synchronous)
   } else {
     _pin = pin;
     _state = IDLE;
-    _readyState = READY_STATE_CHECK_SIM;
+    _readyState = MODEM_THREAD_START;
 
     if (synchronous) {
       unsigned long start = millis();
@@ -73,7 +54,7 @@ GSM3_NetworkStatus_t GSM::begin(const char* pin, bool restart, bool synchronous)
           break;
         }
 
-        delay(100);
+        MODEM.idle(100);
       }
     } else {
       return (GSM3_NetworkStatus_t)0;
@@ -129,196 +110,95 @@ int GSM::ready()
     return 0;
   }
 
-  switch (_readyState) {
-    case READY_STATE_CHECK_SIM: {
-      MODEM.setResponseDataStorage(&_response);
-      MODEM.send("AT+CPIN?");
-      _readyState = READY_STATE_WAIT_CHECK_SIM_RESPONSE;
-      ready = 0;
-      break;
-    }
-
-    case READY_STATE_WAIT_CHECK_SIM_RESPONSE: {
-      if (ready > 1) {
-        // error => retry
-        _readyState = READY_STATE_CHECK_SIM;
-        ready = 0;
-      } else {
-        if (_response.endsWith("READY")) {
-          _readyState = READY_STATE_SET_PREFERRED_MESSAGE_FORMAT;
-          ready = 0;
-        } else if (_response.endsWith("SIM PIN")) {
-          _readyState = READY_STATE_UNLOCK_SIM;
-          ready = 0;
-        } else {
-          _state = ERROR;
-          ready = 2;
-        }
-      }
-
-      break;
-    }
-
-    case READY_STATE_UNLOCK_SIM: {
-      if (_pin != NULL) {
-        MODEM.setResponseDataStorage(&_response);
-        MODEM.sendf("AT+CPIN=\"%s\"", _pin);
-
-        _readyState = READY_STATE_WAIT_UNLOCK_SIM_RESPONSE;
-        ready = 0;
-      } else {
-        _state = ERROR;
-        ready = 2;
-      }
-      break;
-    }
-
-    case READY_STATE_WAIT_UNLOCK_SIM_RESPONSE: {
-      if (ready > 1) {
-        _state = ERROR;
-        ready = 2;
-      } else {
-        _readyState = READY_STATE_SET_PREFERRED_MESSAGE_FORMAT;
-        ready = 0;
-      }
+  // every wait returns 0 and resumes here once the modem has a result in ready
+  MODEM_THREAD_BEGIN(_readyState);
 
-      break;
-    }
+  do {
+    MODEM.setResponseDataStorage(&_response);
+    MODEM.send("AT+CPIN?");
+    MODEM_THREAD_YIELD(_readyState, 0);
 
-    case READY_STATE_SET_PREFERRED_MESSAGE_FORMAT: {
-      MODEM.send("AT+CMGF=1");
-      _readyState = READY_STATE_WAIT_SET_PREFERRED_MESSAGE_FORMAT_RESPONSE;
-      ready = 0;
-      break;
-    }
+    // error => retry
+  } while (ready > 1);
 
-    case READY_STATE_WAIT_SET_PREFERRED_MESSAGE_FORMAT_RESPONSE: {
-      if (ready > 1) {
-        _state = ERROR;
-        ready = 2;
-      } else {
-        _readyState = READY_STATE_SET_HEX_MODE;
-        ready = 0;
-      }
+  if (_response.endsWith("SIM PIN") && _pin != NULL) {
+    MODEM.setResponseDataStorage(&_response);
+    MODEM.sendf("AT+CPIN=\"%s\"", _pin);
+    MODEM_THREAD_YIELD(_readyState, 0);
 
-      break;
+    if (ready > 1) {
+      _state = ERROR;
+      MODEM_THREAD_EXIT(_readyState, 2);
     }
+  } else if (!_response.endsWith("READY")) {
+    _state = ERROR;
+    MODEM_THREAD_EXIT(_readyState, 2);
+  }
 
-    case READY_STATE_SET_HEX_MODE: {
-      MODEM.send("AT+UDCONF=1,1");
-      _readyState = READY_STATE_WAIT_SET_HEX_MODE;
-      ready = 0;
-      break;
-    }
+  MODEM.send("AT+CMGF=1");
+  MODEM_THREAD_YIELD(_readyState, 0);
 
-    case READY_STATE_WAIT_SET_HEX_MODE: {
-      if (ready > 1) {
-        _state = ERROR;
-        ready = 2;
-      } else {
-        _readyState = READY_STATE_SET_AUTOMATIC_TIME_ZONE;
-        ready = 0;
-      }
+  if (ready > 1) {
+    _state = ERROR;
+    MODEM_THREAD_EXIT(_readyState, 2);
+  }
 
-      break;
-    }
+  MODEM.send("AT+UDCONF=1,1");
+  MODEM_THREAD_YIELD(_readyState, 0);
 
-    case READY_STATE_SET_AUTOMATIC_TIME_ZONE: {
-      MODEM.send("AT+CTZU=1");
-      _readyState = READY_STATE_WAIT_SET_AUTOMATIC_TIME_ZONE_RESPONSE;
-      ready = 0;
-      break;
-    }
+  if (ready > 1) {
+    _state = ERROR;
+    MODEM_THREAD_EXIT(_readyState, 2);
+  }
 
-    case READY_STATE_WAIT_SET_AUTOMATIC_TIME_ZONE_RESPONSE: {
-      if (ready > 1) {
-        _state = ERROR;
-        ready = 2;
-      } else {
-        _readyState = READY_STATE_ENABLE_DTMF_DETECTION;
-        ready = 0;
-      }
+  MODEM.send("AT+CTZU=1");
+  MODEM_THREAD_YIELD(_readyState, 0);
 
-      break;
-    }
+  if (ready > 1) {
+    _state = ERROR;
+    MODEM_THREAD_EXIT(_readyState, 2);
+  }
 
-    case READY_STATE_ENABLE_DTMF_DETECTION: {
-      MODEM.send("AT+UDTMFD=1,2");
-      _readyState = READY_STATE_WAIT_ENABLE_DTMF_DETECTION_RESPONSE;
-      ready = 0;
-      break;
-    }
+  MODEM.send("AT+UDTMFD=1,2");
+  MODEM_THREAD_YIELD(_readyState, 0);
 
-    case READY_STATE_WAIT_ENABLE_DTMF_DETECTION_RESPONSE: {
-      if (ready > 1) {
-        _state = ERROR;
-        ready = 2;
-      } else {
-        _readyState = READY_STATE_CHECK_REGISTRATION;
-        ready = 0;
-      }
+  if (ready > 1) {
+    _state = ERROR;
+    MODEM_THREAD_EXIT(_readyState, 2);
+  }
 
-      break;
-    }
+  while (_state != GSM_READY) {
+    MODEM.setResponseDataStorage(&_response);
+    MODEM.send("AT+CREG?");
+    MODEM_THREAD_YIELD(_readyState, 0);
 
-    case READY_STATE_CHECK_REGISTRATION: {
-      MODEM.setResponseDataStorage(&_response);
-      MODEM.send("AT+CREG?");
-      _readyState = READY_STATE_WAIT_CHECK_REGISTRATION_RESPONSE;
-      ready = 0;
-      break;
+    if (ready > 1) {
+      _state = ERROR;
+      MODEM_THREAD_EXIT(_readyState, 2);
     }
 
-    case READY_STATE_WAIT_CHECK_REGISTRATION_RESPONSE: {
-      if (ready > 1) {
-        _state = ERROR;
-        ready = 2;
-      } else {
-        int status = _response.charAt(_response.length() - 1) - '0';
-
-        if (status == 0 || status == 4) {
-          _readyState = READY_STATE_CHECK_REGISTRATION;
-          ready = 0;
-        } else if (status == 1 || status == 5 || status == 8) {
-          _readyState = READY_STATE_SET_REPORTING_CALL_STATUS;
-          _state = GSM_READY;
-          ready = 0;
-        } else if (status == 2) {
-          _readyState = READY_STATE_CHECK_REGISTRATION;
-          _state = CONNECTING;
-          ready = 0;
-        } else if (status == 3) {
-          _state = ERROR;
-          ready = 2;
-        }
-      }
+    int status = _response.charAt(_response.length() - 1) - '0';
 
-      break;
-    }
-
-    case READY_STATE_SET_REPORTING_CALL_STATUS: {
-      MODEM.send("AT+UCALLSTAT=1");
-      _readyState = READY_STATE_WAIT_SET_REPORTING_CALL_STATUS;
-      ready = 0;
-      break;
+    if (status == 1 || status == 5 || status == 8) {
+      _state = GSM_READY;
+    } else if (status == 2) {
+      _state = CONNECTING;
+    } else if (status == 3) {
+      _state = ERROR;
+      MODEM_THREAD_EXIT(_readyState, 2);
     }
+  }
 
-    case READY_STATE_WAIT_SET_REPORTING_CALL_STATUS:{
-      if (ready > 1) {
-        _state = ERROR;
-        ready = 2;
-      } else {
-        _readyState = READY_STATE_DONE;
-        ready = 1;
-      }
-
-      break;
-    }
+  MODEM.send("AT+UCALLSTAT=1");
+  MODEM_THREAD_YIELD(_readyState, 0);
 
-    case READY_STATE_DONE:
-      break;
+  if (ready > 1) {
+    _state = ERROR;
+    MODEM_THREAD_EXIT(_readyState, 2);
   }
 
+  MODEM_THREAD_END(_readyState);
+
   return ready;
 }
 
@@ -19,23 +19,13 @@
 
 #include "Modem.h"
 
+#include "utility/GSMHex.h"
 #include "utility/GSMSocketBuffer.h"
+#include "utility/ModemThread.h"
 
 #include "GSMClient.h"
 
-enum {
-  CLIENT_STATE_IDLE,
-  CLIENT_STATE_CREATE_SOCKET,
-  CLIENT_STATE_WAIT_CREATE_SOCKET_RESPONSE,
-  CLIENT_STATE_ENABLE_SSL,
-  CLIENT_STATE_WAIT_ENABLE_SSL_RESPONSE,
-  CLIENT_STATE_MANAGE_SSL_PROFILE,
-  CLIENT_STATE_WAIT_MANAGE_SSL_PROFILE_RESPONSE,
-  CLIENT_STATE_CONNECT,
-  CLIENT_STATE_WAIT_CONNECT_RESPONSE,
-  CLIENT_STATE_CLOSE_SOCKET,
-  CLIENT_STATE_WAIT_CLOSE_SOCKET
-};
+static const char* const URC_PREFIXES[] = { "+UUSORD", NULL };
 
 GSMClient::GSMClient(bool synch) :
   GSMClient(-1, synch)
@@ -46,19 +36,100 @@ GSMClient::GSMClient(int socket, bool synch) :
   _synch(synch),
   _socket(socket),
   _connected(false),
-  _state(CLIENT_STATE_IDLE),
+  _readyState(MODEM_THREAD_DONE),
   _ip((uint32_t)0),
   _host(NULL),
   _port(0),
   _ssl(false),
   _sslprofile(1),
-  _writeSync(true)
+  _writeSync(true),
+  _binaryMode(false),
+  _writeHead(0),
+  _writePending(0),
+  _writeAcknowledged(0),
+  _writeBuffer(NULL),
+  _writeBufferSize(0),
+  _writeBufferLength(0),
+  _writeBufferDelay(0),
+  _writeBufferDeadline(0)
 {
-  MODEM.addUrcHandler(this);
+  MODEM.addUrcHandler(this, URC_PREFIXES);
+}
+
+GSMClient::GSMClient(const GSMClient& other) :
+  Client(other),
+  ModemUrcHandler(other),
+  ModemPollHandler(other),
+  _synch(other._synch),
+  _socket(other._socket),
+  _connected(other._connected),
+  _readyState(other._readyState),
+  _ip(other._ip),
+  _host(other._host),
+  _port(other._port),
+  _ssl(other._ssl),
+  _sslprofile(other._sslprofile),
+  _writeSync(other._writeSync),
+  _binaryMode(other._binaryMode),
+  _response(other._response),
+  _writeHead(0),
+  _writePending(0),
+  _writeAcknowledged(0),
+  _writeBuffer(NULL),
+  _writeBufferSize(0),
+  _writeBufferLength(0),
+  _writeBufferDelay(0),
+  _writeBufferDeadline(0)
+{
+  // the pipelined chunks in flight call back into the original, so the
+  // copy must not count them as its own
+}
+
+GSMClient& GSMClient::operator=(const GSMClient& other)
+{
+  if (this == &other) {
+    return *this;
+  }
+
+  // this object's own buffered data and chunks go out before the state
+  // they update is replaced
+  flush();
+  waitForWrites();
+  MODEM.removePollHandler(this);
+
+  Client::operator=(other);
+  ModemUrcHandler::operator=(other);
+
+  _synch = other._synch;
+  _socket = other._socket;
+  _connected = other._connected;
+  _readyState = other._readyState;
+  _ip = other._ip;
+  _host = other._host;
+  _port = other._port;
+  _ssl = other._ssl;
+  _sslprofile = other._sslprofile;
+  _writeSync = other._writeSync;
+  _binaryMode = other._binaryMode;
+  _response = other._response;
+  _writeHead = 0;
+  _writePending = 0;
+  _writeAcknowledged = 0;
+  _writeBuffer = NULL;
+  _writeBufferSize = 0;
+  _writeBufferLength = 0;
+  _writeBufferDelay = 0;
+  _writeBufferDeadline = 0;
+
+  return *this;
 }
 
 GSMClient::~GSMClient()
 {
+  // the pipelined chunks call back into this object
+  waitForWrites();
+
+  MODEM.removePollHandler(this);
   MODEM.removeUrcHandler(this);
 }
 
@@ -70,116 +141,55 @@ int GSMClient::ready()
     return 0;
   }
 
-  switch (_state) {
-    case CLIENT_STATE_IDLE:
-    default: {
-      break;
-    }
-
-    case CLIENT_STATE_CREATE_SOCKET: {
-      MODEM.setResponseDataStorage(&_response);
-      MODEM.send("AT+USOCR=6");
-
-      _state = CLIENT_STATE_WAIT_CREATE_SOCKET_RESPONSE;
-      ready = 0;
-      break;
-    }
+  // every wait returns 0 and resumes here once the modem has a result in ready,
+  // connect() starts the thread over
+  MODEM_THREAD_BEGIN(_readyState);
 
-    case CLIENT_STATE_WAIT_CREATE_SOCKET_RESPONSE: {
-      if (ready > 1 || !_response.startsWith("+USOCR: ")) {
-        _state = CLIENT_STATE_IDLE;
-      } else {
-        _socket = _response.charAt(_response.length() - 1) - '0';
+  MODEM.setResponseDataStorage(&_response);
+  MODEM.send("AT+USOCR=6");
+  MODEM_THREAD_YIELD(_readyState, 0);
 
-        if (_ssl) {
-          _state = CLIENT_STATE_ENABLE_SSL;
-        } else {
-          _state = CLIENT_STATE_CONNECT;
-        }
-
-        ready = 0;
-      }
-      break;
-    }
+  if (ready > 1 || !_response.startsWith("+USOCR: ")) {
+    MODEM_THREAD_EXIT(_readyState, ready);
+  }
 
-    case CLIENT_STATE_ENABLE_SSL: {
-      MODEM.sendf("AT+USOSEC=%d,1,0", _socket);
+  _socket = _response.charAt(_response.length() - 1) - '0';
 
-      _state = CLIENT_STATE_WAIT_ENABLE_SSL_RESPONSE;
-      ready = 0;
-      break;
-    }
+  // the modem reuses socket numbers, forget what the last one left behind
+  GSMSocketBuffer.close(_socket);
+  GSMSocketBuffer.setBinaryMode(_socket, _binaryMode);
 
-    case CLIENT_STATE_WAIT_ENABLE_SSL_RESPONSE: {
-      if (ready > 1) {
-        _state = CLIENT_STATE_CLOSE_SOCKET;
-      } else {
-        _state = CLIENT_STATE_MANAGE_SSL_PROFILE;
-      }
+  if (_ssl) {
+    MODEM.sendf("AT+USOSEC=%d,1,0", _socket);
+    MODEM_THREAD_YIELD(_readyState, 0);
 
-      ready = 0;
-      break;
-    }
-
-    case CLIENT_STATE_MANAGE_SSL_PROFILE: {
+    if (ready == 1) {
       MODEM.sendf("AT+USECPRF=0,0,%d",_sslprofile);
-
-      _state = CLIENT_STATE_WAIT_MANAGE_SSL_PROFILE_RESPONSE;
-      ready = 0;
-      break;
+      MODEM_THREAD_YIELD(_readyState, 0);
     }
-  
-    case CLIENT_STATE_WAIT_MANAGE_SSL_PROFILE_RESPONSE: {
-      if (ready > 1) {
-        _state = CLIENT_STATE_CLOSE_SOCKET;
-      } else {
-        _state = CLIENT_STATE_CONNECT;
-      }
-
-      ready = 0;
-      break;
-    } 
-
-    case CLIENT_STATE_CONNECT: {
-      if (_host != NULL) {
-        MODEM.sendf("AT+USOCO=%d,\"%s\",%d", _socket, _host, _port);
-      } else {
-        MODEM.sendf("AT+USOCO=%d,\"%d.%d.%d.%d\",%d", _socket, _ip[0], _ip[1], _ip[2], _ip[3], _port);
-      }
+  }
 
-      _state = CLIENT_STATE_WAIT_CONNECT_RESPONSE;
-      ready = 0;
-      break;
+  if (ready == 1) {
+    if (_host != NULL) {
+      MODEM.sendf("AT+USOCO=%d,\"%s\",%d", _socket, _host, _port);
+    } else {
+      MODEM.sendf("AT+USOCO=%d,\"%d.%d.%d.%d\",%d", _socket, _ip[0], _ip[1], _ip[2], _ip[3], _port);
     }
+    MODEM_THREAD_YIELD(_readyState, 0);
+  }
 
-    case CLIENT_STATE_WAIT_CONNECT_RESPONSE: {
-      if (ready > 1) {
-        _state = CLIENT_STATE_CLOSE_SOCKET;
-
-        ready = 0;
-      } else {
-        _connected = true;
-        _state = CLIENT_STATE_IDLE;
-      }
-      break;
-    }
-
-    case CLIENT_STATE_CLOSE_SOCKET: {
-
-      MODEM.sendf("AT+USOCL=%d", _socket);
-
-      _state = CLIENT_STATE_WAIT_CLOSE_SOCKET;
-      ready = 0;
-      break;
-    }
+  if (ready > 1) {
+    // SSL setup or connect failed, close the socket again
+    MODEM.sendf("AT+USOCL=%d", _socket);
+    MODEM_THREAD_YIELD(_readyState, 0);
 
-    case CLIENT_STATE_WAIT_CLOSE_SOCKET: {
-      _state = CLIENT_STATE_IDLE;
-      _socket = -1;
-      break;
-    }
+    _socket = -1;
+  } else {
+    _connected = true;
   }
 
+  MODEM_THREAD_END(_readyState);
+
   return ready;
 }
 
@@ -235,11 +245,11 @@ int GSMClient::connect()
     return 0;
   }
 
-  _state = CLIENT_STATE_CREATE_SOCKET;
+  _readyState = MODEM_THREAD_START;
 
   if (_synch) {
     while (ready() == 0) {
-      delay(100);
+      MODEM.idle(100);
     }
 
     if (_socket == -1) {
@@ -253,6 +263,8 @@ int GSMClient::connect()
 void GSMClient::beginWrite(bool sync)
 {
   _writeSync = sync;
+  _writeAcknowledged = 0;
+  clearWriteError();
 }
 
 size_t GSMClient::write(uint8_t c)
@@ -267,48 +279,169 @@ size_t GSMClient::write(const uint8_t *buf)
 
 size_t GSMClient::write(const uint8_t* buf, size_t size)
 {
-  if (_writeSync) {
+  ModemSegment segment = { buf, size };
+
+  return writev(&segment, 1);
+}
+
+size_t GSMClient::writev(const ModemSegment* segments, int count)
+{
+  size_t size = 0;
+
+  for (int i = 0; i < count; i++) {
+    size += segments[i].size;
+  }
+
+  if (_writeBuffer == NULL) {
+    return writeSegments(segments, count);
+  }
+
+  if (_writeBufferLength + size > _writeBufferSize) {
+    flush();
+
+    if (_writeBufferLength) {
+      return 0;
+    }
+
+    if (size > _writeBufferSize) {
+      return writeSegments(segments, count);
+    }
+  }
+
+  if (_writeBufferLength == 0 && size && _writeBufferDelay) {
+    // start the coalescing timer, MODEM.poll() sends the data when it expires
+    _writeBufferDeadline = MODEM.deadline(_writeBufferDelay);
+    MODEM.addPollHandler(this);
+  }
+
+  for (int i = 0; i < count; i++) {
+    memcpy(_writeBuffer + _writeBufferLength, segments[i].data, segments[i].size);
+    _writeBufferLength += segments[i].size;
+  }
+
+  if (_writeBufferLength == _writeBufferSize) {
+    flush();
+  }
+
+  return size;
+}
+
+void GSMClient::setWriteBuffer(uint8_t* buffer, size_t size, unsigned long maxDelay)
+{
+  flush();
+
+  _writeBuffer = buffer;
+  _writeBufferSize = size;
+  _writeBufferLength = 0;
+  _writeBufferDelay = maxDelay;
+  MODEM.removePollHandler(this);
+}
+
+// returns the next piece of at most length bytes and moves past it
+static const uint8_t* nextPiece(const ModemSegment*& segment, size_t& offset, size_t& length)
+{
+  while (offset == segment->size) {
+    segment++;
+    offset = 0;
+  }
+
+  if (length > segment->size - offset) {
+    length = segment->size - offset;
+  }
+
+  const uint8_t* data = segment->data + offset;
+
+  offset += length;
+
+  return data;
+}
+
+size_t GSMClient::writeSegments(const ModemSegment* segments, int count)
+{
+  // only hex writes are pipelined, binary writes need the prompt of
+  // each chunk, either way they must not overtake queued chunks
+  bool pipelined = !_writeSync && !_binaryMode;
+
+  if (pipelined && MODEM.hexMode() == 1) {
+    // the chunks are queued behind whatever the modem is busy with, so
+    // only this client's own commands have to be done, queueWrite()
+    // holds back when the queue is full
+    ready();
+
+    if (!MODEM_THREAD_FINISHED(_readyState)) {
+      return 0;
+    }
+  } else if (_writeSync) {
     while (ready() == 0);
   } else if (ready() == 0) {
     return 0;
   }
 
+  if (!pipelined) {
+    waitForWrites();
+  }
+
   if (_socket == -1) {
     return 0;
   }
 
+  if (!_binaryMode && !MODEM.setHexMode(true)) {
+    return 0;
+  }
+
+  size_t size = 0;
+
+  for (int i = 0; i < count; i++) {
+    size += segments[i].size;
+  }
+
+  const ModemSegment* segment = segments;
+  size_t offset = 0;
   size_t written = 0;
   String command;
 
-  command.reserve(19 + (size > 256 ? 256 : size) * 2);
+  if (!_binaryMode) {
+    command.reserve(19 + (size > 256 ? 256 : size) * 2);
+  }
 
   while (size) {
     size_t chunkSize = size;
 
-    if (chunkSize > 256) {
-      chunkSize = 256;
-    }
+    if (_binaryMode) {
+      if (chunkSize > 1024) {
+        chunkSize = 1024;
+      }
 
-    command = "AT+USOWR=";
-    command += _socket;
-    command += ",";
-    command += chunkSize;
-    command += ",\"";
+      MODEM.sendf("AT+USOWR=%d,%d", _socket, chunkSize);
+      if (MODEM.waitForPrompt(10000, '@') != 1) {
+        break;
+      }
 
-    for (size_t i = 0; i < chunkSize; i++) {
-      byte b = buf[i + written];
+      // the modem needs at least 50 ms after the prompt before it accepts data
+      delay(50);
 
-      byte n1 = (b >> 4) & 0x0f;
-      byte n2 = (b & 0x0f);
+      for (size_t remaining = chunkSize; remaining;) {
+        size_t length = remaining;
+        const uint8_t* data = nextPiece(segment, offset, length);
 
-      command += (char)(n1 > 9 ? 'A' + n1 - 10 : '0' + n1);
-      command += (char)(n2 > 9 ? 'A' + n2 - 10 : '0' + n2);
-    }
+        MODEM.write(data, length);
+        remaining -= length;
+      }
+    } else {
+      if (chunkSize > 256) {
+        chunkSize = 256;
+      }
 
-    command += "\"";
+      hexWriteCommand(command, segment, offset, chunkSize);
 
-    MODEM.send(command);
-    if (_writeSync) {
+      if (!pipelined) {
+        MODEM.send(command);
+      } else if (!queueWrite(command, chunkSize)) {
+        break;
+      }
+    }
+
+    if (!pipelined) {
       if (MODEM.waitForResponse(10000) != 1) {
         break;
       }
@@ -321,11 +454,129 @@ size_t GSMClient::write(const uint8_t* buf, size_t size)
   return written;
 }
 
-void GSMClient::endWrite(bool /*sync*/)
+void GSMClient::hexWriteCommand(String& command, const ModemSegment*& segment, size_t& offset, size_t size)
 {
+  command = "AT+USOWR=";
+  command += _socket;
+  command += ",";
+  command += size;
+  command += ",\"";
+
+  for (size_t remaining = size; remaining;) {
+    size_t length = remaining;
+    const uint8_t* data = nextPiece(segment, offset, length);
+
+    GSMHex::encode(data, length, command);
+    remaining -= length;
+  }
+
+  command += "\"";
+}
+
+void GSMClient::endWrite(bool sync)
+{
+  if (sync) {
+    waitForWrites();
+  }
+
   _writeSync = true;
 }
 
+int GSMClient::writePending()
+{
+  MODEM.poll();
+
+  return _writePending;
+}
+
+size_t GSMClient::writeAcknowledged()
+{
+  return _writeAcknowledged;
+}
+
+bool GSMClient::queueWrite(const String& command, size_t size)
+{
+  // keep at most GSM_CLIENT_WRITE_WINDOW chunks in flight, give up when
+  // no slot frees up within the AT+USOWR timeout
+  unsigned long deadline = MODEM.deadline(10000);
+
+  while (_writePending == GSM_CLIENT_WRITE_WINDOW || MODEM.backgroundAvailable() == 0) {
+    if (MODEM.expired(deadline)) {
+      setWriteError();
+      return false;
+    }
+
+    MODEM.poll();
+    MODEM.idle();
+  }
+
+  int index = (_writeHead + _writePending) % GSM_CLIENT_WRITE_WINDOW;
+
+  _writeWindow[index].response = "";
+  _writeWindow[index].size = size;
+
+  if (!MODEM.sendBackground(command.c_str(), 10000, writeCompletedCallback, this, &_writeWindow[index].response)) {
+    return false;
+  }
+
+  _writePending++;
+
+  return true;
+}
+
+void GSMClient::waitForWrites()
+{
+  // every acknowledged chunk restarts the AT+USOWR timeout
+  unsigned long deadline = MODEM.deadline(10000);
+  int pending = _writePending;
+
+  while (_writePending) {
+    if (_writePending < pending) {
+      pending = _writePending;
+      deadline = MODEM.deadline(10000);
+    } else if (MODEM.expired(deadline)) {
+      // the window stopped draining, give up on the rest
+      setWriteError();
+      MODEM.cancelBackground(this);
+      _writePending = 0;
+      break;
+    }
+
+    MODEM.poll();
+    MODEM.idle();
+  }
+}
+
+void GSMClient::writeCompleted(int status)
+{
+  // background commands complete in order, so this is the oldest chunk
+  ModemLine ack(_writeWindow[_writeHead].response);
+  size_t size = _writeWindow[_writeHead].size;
+
+  _writeHead = (_writeHead + 1) % GSM_CLIENT_WRITE_WINDOW;
+  _writePending--;
+
+  if (status != 1 || !ack.is("+USOWR") || ack.fieldInt(0) != _socket) {
+    setWriteError();
+    return;
+  }
+
+  size_t accepted = ack.fieldUnsigned(1);
+
+  if (accepted < size) {
+    setWriteError();
+  } else {
+    accepted = size;
+  }
+
+  _writeAcknowledged += accepted;
+}
+
+void GSMClient::writeCompletedCallback(int status, void* context)
+{
+  ((GSMClient*)context)->writeCompleted(status);
+}
+
 uint8_t GSMClient::connected()
 {
   MODEM.poll();
@@ -368,6 +619,15 @@ int GSMClient::read(uint8_t *buf, size_t size)
   return GSMSocketBuffer.read(_socket, buf, size);
 }
 
+int GSMClient::readBulk(uint8_t *buf, size_t size, unsigned long timeout)
+{
+  if (_socket == -1) {
+    return 0;
+  }
+
+  return GSMSocketBuffer.readDirect(_socket, buf, size, timeout);
+}
+
 int GSMClient::read()
 {
   byte b;
@@ -413,16 +673,48 @@ int GSMClient::peek()
 
 void GSMClient::flush()
 {
+  if (_writeBufferLength == 0) {
+    return;
+  }
+
+  ModemSegment segment = { _writeBuffer, _writeBufferLength };
+  size_t written = writeSegments(&segment, 1);
+
+  // keep what didn't go out, the next flush() retries it
+  _writeBufferLength -= written;
+  memmove(_writeBuffer, _writeBuffer + written, _writeBufferLength);
+
+  if (_writeBufferLength == 0) {
+    MODEM.removePollHandler(this);
+  }
 }
 
 void GSMClient::stop()
 {
-  _state = CLIENT_STATE_IDLE;
+  _readyState = MODEM_THREAD_DONE;
 
   if (_socket < 0) {
     return;
   }
 
+  // the socket is closed right after, so send what is buffered
+  // synchronously instead of giving up when the modem is busy
+  bool writeSync = _writeSync;
+
+  _writeSync = true;
+  flush();
+  _writeSync = writeSync;
+
+  waitForWrites();
+
+  if (_writeBufferLength) {
+    // the modem didn't take it
+    setWriteError();
+    _writeBufferLength = 0;
+  }
+
+  MODEM.removePollHandler(this);
+
   MODEM.sendf("AT+USOCL=%d", _socket);
   MODEM.waitForResponse(10000);
 
@@ -431,19 +723,59 @@ void GSMClient::stop()
   _connected = false;
 }
 
-void GSMClient::handleUrc(const String& urc)
+void GSMClient::handleUrc(const ModemLine& urc)
 {
-  if (urc.startsWith("+UUSORD: ")) {
-    int socket = urc.charAt(9) - '0';
+  if (urc.is("+UUSORD")) {
+    int socket = urc.fieldInt(0);
 
     if (socket == _socket) {
-      if (urc.endsWith(",4294967295")) {
+      if (urc.fieldUnsigned(1) == 4294967295UL) {
         _connected = false;
       }
     }
   }
 }
 
+void GSMClient::handlePoll()
+{
+  // poll() can't wait for a prompt or switch the hex mode, binary data
+  // waits for the next write or flush() instead
+  if (!MODEM.expired(_writeBufferDeadline) || _binaryMode || MODEM.hexMode() != 1 || _socket == -1) {
+    return;
+  }
+
+  String command;
+
+  while (_writeBufferLength && _writePending < GSM_CLIENT_WRITE_WINDOW && MODEM.backgroundAvailable() > 0) {
+    ModemSegment buffer = { _writeBuffer, _writeBufferLength };
+    const ModemSegment* segment = &buffer;
+    size_t offset = 0;
+    size_t chunkSize = _writeBufferLength > 256 ? 256 : _writeBufferLength;
+
+    hexWriteCommand(command, segment, offset, chunkSize);
+
+    if (!queueWrite(command, chunkSize)) {
+      break;
+    }
+
+    _writeBufferLength -= chunkSize;
+    memmove(_writeBuffer, _writeBuffer + chunkSize, _writeBufferLength);
+  }
+
+  if (_writeBufferLength == 0) {
+    MODEM.removePollHandler(this);
+  }
+}
+
 void GSMClient::setCertificateValidationLevel(uint8_t ssl) {
   _sslprofile = ssl;
 }
+
+void GSMClient::setBinaryMode(bool binary)
+{
+  _binaryMode = binary;
+
+  if (_socket != -1) {
+    GSMSocketBuffer.setBinaryMode(_socket, _binaryMode);
+  }
+}
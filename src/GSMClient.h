@@ -24,7 +24,7 @@
 
 #include <Client.h>
 
-class GSMClient : public Client, public ModemUrcHandler {
+class GSMClient : public Client, public ModemUrcHandler, public ModemPollHandler {
 
 public:
 
@@ -39,6 +39,12 @@ public:
    */
   GSMClient(int socket, bool synch);
 
+  /** Copy constructor and assignment, the copy starts without pipelined
+      writes in flight and without a write buffer, those stay with the original
+   */
+  GSMClient(const GSMClient& other);
+  GSMClient& operator=(const GSMClient& other);
+
   virtual ~GSMClient();
 
   /** Get last command status
@@ -64,7 +70,9 @@ public:
   int connectSSL(const char *host, uint16_t port);
 
   /** Initialize write in request
-      @param sync     Sync mode
+      @param sync     Sync mode, in async mode hex writes are pipelined: up to
+                      GSM_CLIENT_WRITE_WINDOW chunks are queued without waiting
+                      for the modem to acknowledge them
    */
   void beginWrite(bool sync = false);
 
@@ -87,11 +95,38 @@ public:
    */
   size_t write(const uint8_t*, size_t);
 
+  /** Write several buffers as if they were one, they are encoded straight
+      into the AT+USOWR commands without being copied together first
+      @param segments Buffers to write, in order
+      @param count    Number of buffers
+      @return bytes written
+   */
+  size_t writev(const ModemSegment* segments, int count);
+
+  /** Coalesce small writes in a buffer, it is sent when full, on flush() and on stop()
+      @param buffer   Buffer provided by the sketch, NULL to write straight through
+      @param size     Buffer size
+      @param maxDelay If not 0, MODEM.poll() sends buffered hex data in the background
+                      at the latest maxDelay ms after the first byte was buffered
+   */
+  void setWriteBuffer(uint8_t* buffer, size_t size, unsigned long maxDelay = 0);
+
   /** Finish write request
-      @param sync     Sync mode
+      @param sync     Sync mode, wait until all pipelined chunks are acknowledged
    */
   void endWrite(bool sync = false);
 
+  /** Number of pipelined chunks still waiting for their acknowledgement
+      @return chunks in flight
+   */
+  int writePending();
+
+  /** Bytes of pipelined writes acknowledged by the modem since beginWrite(),
+      getWriteError() is set when a chunk failed or was only partially accepted
+      @return acknowledged bytes
+   */
+  size_t writeAcknowledged();
+
   /** Check if connected to server
       @return 1 if connected
    */
@@ -106,6 +141,17 @@ public:
    */
   int read(uint8_t *buf, size_t size);
 
+  /** Read in bulk, AT+USORD is sized to the request and the data is decoded
+      straight into buf instead of going through the socket buffer
+      @param buf      Buffer
+      @param size     Buffer size
+      @param timeout  Keep waiting for more data until size bytes were read or
+                      timeout ms passed, 0 only reads what the modem holds now
+                      and doesn't wait for a read ahead that is on the way
+      @return bytes read
+   */
+  int readBulk(uint8_t *buf, size_t size, unsigned long timeout = 0);
+
   /** Read a character from response buffer
       @return character
    */
@@ -121,7 +167,7 @@ public:
    */
   int peek();
 
-  /** Flush response buffer
+  /** Send the data held in the write buffer
    */
   void flush();
 
@@ -133,16 +179,28 @@ public:
    */
   void setCertificateValidationLevel(uint8_t ssl);
 
-  virtual void handleUrc(const String& urc);
+  /** Select binary (raw) or hex encoded socket reads and writes, hex is the default
+      @param binary   true to transfer raw bytes
+   */
+  void setBinaryMode(bool binary);
+
+  virtual void handleUrc(const ModemLine& urc);
+  virtual void handlePoll();
 
 private:
   int connect();
+  size_t writeSegments(const ModemSegment* segments, int count);
+  void hexWriteCommand(String& command, const ModemSegment*& segment, size_t& offset, size_t size);
+  bool queueWrite(const String& command, size_t size);
+  void waitForWrites();
+  void writeCompleted(int status);
+  static void writeCompletedCallback(int status, void* context);
 
   bool _synch;
   int _socket;
   int _connected;
 
-  int _state;
+  int _readyState;
   IPAddress _ip;
   const char* _host;
   uint16_t _port;
@@ -150,7 +208,25 @@ private:
 
   int _sslprofile;
   bool _writeSync;
+  bool _binaryMode;
   String _response;
+
+  #ifndef GSM_CLIENT_WRITE_WINDOW
+  #define GSM_CLIENT_WRITE_WINDOW 4
+  #endif
+  struct {
+    String response;
+    size_t size;
+  } _writeWindow[GSM_CLIENT_WRITE_WINDOW];
+  int _writeHead;
+  int _writePending;
+  size_t _writeAcknowledged;
+
+  uint8_t* _writeBuffer;
+  size_t _writeBufferSize;
+  size_t _writeBufferLength;
+  unsigned long _writeBufferDelay;
+  unsigned long _writeBufferDeadline;
 };
 
 #endif
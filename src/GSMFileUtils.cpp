@@ -1,7 +1,98 @@
 #include "Modem.h"
+#include "utility/GSMHex.h"
 
 #include "GSMFileUtils.h"
 
+// Decodes the hex payload of a +URDFILE or +URDBLOCK response while it is
+// received: <name>,<size>,"<hex>" - the file never sits in RAM as hex
+class GSMFileReadSink : public Print {
+public:
+    GSMFileReadSink(uint8_t* data, size_t maxSize, String* string)
+        : _data(data)
+        , _string(string)
+        , _maxSize(maxSize)
+        , _size(0)
+        , _announced(0)
+        , _hexLength(0)
+        , _commas(0)
+        , _quoted(false)
+        , _done(false)
+        , _error(false)
+    {
+    }
+
+    virtual size_t write(uint8_t c)
+    {
+        if (_done || _error)
+            return 1;
+
+        if (_commas < 2 || !_quoted) {
+            // skip the header up to the quote that opens the payload
+            if (c == '"')
+                _quoted = !_quoted;
+            else if (c == ',' && !_quoted && ++_commas == 2 && _string != NULL)
+                _string->reserve(_announced / 2);
+            else if (_commas == 1 && c >= '0' && c <= '9')
+                _announced = _announced * 10 + (c - '0');
+
+            return 1;
+        }
+
+        if (c == '"') {
+            flush();
+            _done = true;
+            return 1;
+        }
+
+        _hex[_hexLength++] = c;
+
+        if (_hexLength == sizeof(_hex))
+            flush();
+
+        return 1;
+    }
+
+    using Print::write;
+
+    size_t size() const { return _size; }
+    bool valid() const { return _done && !_error; }
+
+private:
+    void flush()
+    {
+        uint8_t chunk[sizeof(_hex) / 2];
+        int decoded = GSMHex::decode(_hex, _hexLength, chunk);
+
+        _hexLength = 0;
+
+        if (decoded < 0 || _size + decoded > _maxSize) {
+            _error = true;
+            return;
+        }
+
+        for (int i = 0; i < decoded; i++) {
+            if (_data != NULL)
+                _data[_size] = chunk[i];
+            else
+                (*_string) += (char)chunk[i];
+
+            _size++;
+        }
+    }
+
+    uint8_t* _data;
+    String* _string;
+    size_t _maxSize;
+    size_t _size;
+    size_t _announced;
+    char _hex[64];
+    size_t _hexLength;
+    int _commas;
+    bool _quoted;
+    bool _done;
+    bool _error;
+};
+
 GSMFileUtils::GSMFileUtils(bool debug)
     : _count(0)
     , _files("")
@@ -94,19 +185,10 @@ uint32_t GSMFileUtils::downloadFile(const String filename, const char buf[], uin
     MODEM.sendf("AT+UDWNFILE=\"%s\",%d", filename.c_str(), size * 2);
     MODEM.waitForPrompt(20000);
 
-    char hex[size * 2] { 0 };
+    char hex[size * 2];
 
-    for (auto i = 0; i < size; i++) {
-        byte b = buf[i];
-
-        byte n1 = (b >> 4) & 0x0f;
-        byte n2 = (b & 0x0f);
-
-        hex[i * 2] = (char)(n1 > 9 ? 'A' + n1 - 10 : '0' + n1);
-        hex[i * 2 + 1] = (char)(n2 > 9 ? 'A' + n2 - 10 : '0' + n2);
-    }
-    for (auto h : hex)
-        MODEM.write(h);
+    GSMHex::encode(reinterpret_cast<const uint8_t*>(buf), size, hex);
+    MODEM.write(reinterpret_cast<const uint8_t*>(hex), size * 2);
 
     int status = MODEM.waitForResponse(1000);
     if (status != 1)
@@ -123,149 +205,56 @@ uint32_t GSMFileUtils::downloadFile(const String filename, const char buf[], uin
 
 uint32_t GSMFileUtils::readFile(const String filename, String* content)
 {
-    String response;
-
     if (!listFile(filename)) {
         return 0;
     }
 
-    MODEM.sendf("AT+URDFILE=\"%s\"", filename.c_str());
-    MODEM.waitForResponse(1000, &response);
-
-    size_t skip = 10;
-    String _content = response.substring(skip);
-
-    int commaIndex = _content.indexOf(',');
-    skip += commaIndex;
-
-    _content = _content.substring(commaIndex + 1);
-    commaIndex = _content.indexOf(',');
-    skip += commaIndex;
-
-    String sizePart = _content.substring(0, commaIndex);
-    uint32_t size = sizePart.toInt() / 2;
-    skip += 3;
-
     String* _data = content;
     (*_data) = "";
-    (*_data).reserve(size);
-
-    for (auto i = 0; i < size; i++) {
-        byte n1 = response[skip + i * 2];
-        byte n2 = response[skip + i * 2 + 1];
 
-        if (n1 > '9') {
-            n1 = (n1 - 'A') + 10;
-        } else {
-            n1 = (n1 - '0');
-        }
+    GSMFileReadSink sink(NULL, (size_t)-1, _data);
 
-        if (n2 > '9') {
-            n2 = (n2 - 'A') + 10;
-        } else {
-            n2 = (n2 - '0');
-        }
+    MODEM.sendf("AT+URDFILE=\"%s\"", filename.c_str());
+    MODEM.waitForResponse(1000, sink);
 
-        (*_data) += (char)((n1 << 4) | n2);
-    }
+    if (!sink.valid())
+        return 0;
 
     return (*_data).length();
 }
 
 uint32_t GSMFileUtils::readFile(const String filename, uint8_t* content)
 {
-    String response;
-
     if (listFile(filename) == 0) {
         return 0;
     }
 
-    MODEM.sendf("AT+URDFILE=\"%s\"", filename.c_str());
-    MODEM.waitForResponse(1000, &response);
-
-    size_t skip = 10;
-    String _content = response.substring(skip);
-
-    int commaIndex = _content.indexOf(',');
-    skip += commaIndex;
-
-    _content = _content.substring(commaIndex + 1);
-    commaIndex = _content.indexOf(',');
-    skip += commaIndex;
+    GSMFileReadSink sink(content, (size_t)-1, NULL);
 
-    String sizePart = _content.substring(0, commaIndex);
-    uint32_t size = sizePart.toInt() / 2;
-    skip += 3;
-
-    memset(content, 0, size);
-
-    for (auto i = 0; i < size; i++) {
-        byte n1 = response[skip + i * 2];
-        byte n2 = response[skip + i * 2 + 1];
-
-        if (n1 > '9') {
-            n1 = (n1 - 'A') + 10;
-        } else {
-            n1 = (n1 - '0');
-        }
-
-        if (n2 > '9') {
-            n2 = (n2 - 'A') + 10;
-        } else {
-            n2 = (n2 - '0');
-        }
+    MODEM.sendf("AT+URDFILE=\"%s\"", filename.c_str());
+    MODEM.waitForResponse(1000, sink);
 
-        content[i] = (n1 << 4) | n2;
-    }
+    if (!sink.valid())
+        return 0;
 
-    return size;
+    return sink.size();
 }
 
 uint32_t GSMFileUtils::readBlock(const String filename, const uint32_t offset, const uint32_t len, uint8_t* content)
 {
-    String response;
-
     if (listFile(filename) == 0) {
         return 0;
     }
 
-    MODEM.sendf("AT+URDBLOCK=\"%s\",%d,%d", filename.c_str(), offset * 2, len * 2);
-    MODEM.waitForResponse(1000, &response);
-
-    size_t skip = 10;
-    String _content = response.substring(skip);
-
-    int commaIndex = _content.indexOf(',');
-    skip += commaIndex;
-
-    _content = _content.substring(commaIndex + 1);
-    commaIndex = _content.indexOf(',');
-    skip += commaIndex;
-
-    String sizePart = _content.substring(0, commaIndex);
-    uint32_t size = sizePart.toInt() / 2;
-    skip += 3;
+    GSMFileReadSink sink(content, len, NULL);
 
-    for (auto i = 0; i < size; i++) {
-        byte n1 = response[skip + i * 2];
-        byte n2 = response[skip + i * 2 + 1];
-
-        if (n1 > '9') {
-            n1 = (n1 - 'A') + 10;
-        } else {
-            n1 = (n1 - '0');
-        }
-
-        if (n2 > '9') {
-            n2 = (n2 - 'A') + 10;
-        } else {
-            n2 = (n2 - '0');
-        }
+    MODEM.sendf("AT+URDBLOCK=\"%s\",%d,%d", filename.c_str(), offset * 2, len * 2);
+    MODEM.waitForResponse(1000, sink);
 
-        content[i] = (n1 << 4) | n2;
-    }
+    if (!sink.valid())
+        return 0;
 
-    return size;
+    return sink.size();
 }
 
 bool GSMFileUtils::deleteFile(const String filename)
@@ -27,13 +27,15 @@
 
 bool GSMHttpUtils::_rootCertsLoaded = false;
 
+static const char* const URC_PREFIXES[] = { "+UUHTTPCR", NULL };
+
 GSMHttpUtils::GSMHttpUtils() :
   _gsmRoots(GSM_ROOT_CERTS),
   _sizeRoot(GSM_NUM_ROOT_CERTS),
   _httpresp(false),
   _ssl(false)
 {
-  MODEM.addUrcHandler(this);
+  MODEM.addUrcHandler(this, URC_PREFIXES);
 }
 
 GSMHttpUtils::~GSMHttpUtils()
@@ -138,11 +140,11 @@ void GSMHttpUtils::setUserRoots(const GSMRootCert * userRoots, size_t size) {
   _sizeRoot = size;
 }
 
-void GSMHttpUtils::handleUrc(const String& urc)
+void GSMHttpUtils::handleUrc(const ModemLine& urc)
 {
-  if (urc.startsWith("+UUHTTPCR: ")) {
+  if (urc.is("+UUHTTPCR")) {
       _httpresp = false;
-      if (urc.endsWith(",1")) {
+      if (urc.fieldEquals(urc.fields() - 1, "1")) {
         _httpresp = true;
       }
      
@@ -37,7 +37,7 @@ public:
   virtual void eraseTrustedRoot();
   virtual void eraseAllCertificates();
   virtual void eraseCert(const char* name, int type);
-  virtual void handleUrc(const String& urc);
+  virtual void handleUrc(const ModemLine& urc);
   virtual void enableSSL();
   virtual void disableSSL();
   virtual void configServer(const char* url, int httpport);
@@ -21,6 +21,8 @@
 
 #define GSM_LOCATION_UPDATE_INTERVAL 1100
 
+static const char* const URC_PREFIXES[] = { "+UULOC", NULL };
+
 GSMLocation::GSMLocation() :
   _commandSent(false),
   _locationAvailable(false),
@@ -29,7 +31,7 @@ GSMLocation::GSMLocation() :
   _altitude(0),
   _uncertainty(0)
 {
-  MODEM.addUrcHandler(this);
+  MODEM.addUrcHandler(this, URC_PREFIXES);
 }
 
 GSMLocation::~GSMLocation()
@@ -90,28 +92,17 @@ long GSMLocation::accuracy()
   return _uncertainty;
 }
 
-void GSMLocation::handleUrc(const String& urc)
+void GSMLocation::handleUrc(const ModemLine& urc)
 {
-  if (urc.startsWith("+UULOC: ")) {
-    String temp = urc;
-    int lastCommaIndex;
+  if (urc.is("+UULOC")) {
+    // +UULOC: <date>,<time>,<lat>,<long>,<alt>,<uncertainty>
+    int fields = urc.fields();
 
     _locationAvailable = true;
 
-    lastCommaIndex = temp.lastIndexOf(',');
-    _uncertainty = temp.substring(lastCommaIndex + 1).toInt();
-    temp.remove(lastCommaIndex);
-
-    lastCommaIndex = temp.lastIndexOf(',');
-    _altitude = temp.substring(lastCommaIndex + 1).toInt();
-    temp.remove(lastCommaIndex);
-
-    lastCommaIndex = temp.lastIndexOf(',');
-    _longitude = temp.substring(lastCommaIndex + 1).toFloat();
-    temp.remove(lastCommaIndex);
-
-    lastCommaIndex = temp.lastIndexOf(',');
-    _latitude = temp.substring(lastCommaIndex + 1).toFloat();
-    temp.remove(lastCommaIndex);
+    _latitude = urc.fieldFloat(fields - 4);
+    _longitude = urc.fieldFloat(fields - 3);
+    _altitude = urc.fieldInt(fields - 2);
+    _uncertainty = urc.fieldInt(fields - 1);
   }
 }
@@ -39,7 +39,7 @@ public:
   long altitude();
   long accuracy();
 
-  void handleUrc(const String& urc);
+  void handleUrc(const ModemLine& urc);
 
 private:
   bool _commandSent;
@@ -17,6 +17,8 @@
   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
+#include "utility/GSMSocketBuffer.h"
+
 #include "GSMServer.h"
 
 enum {
@@ -29,6 +31,8 @@ enum {
   SERVER_STATE_WAIT_CLOSE_SOCKET
 };
 
+static const char* const URC_PREFIXES[] = { "+UUSOLI", "+UUSOCL", "+UUSORD", NULL };
+
 GSMServer::GSMServer(uint16_t port, bool synch) :
   _port(port),
   _synch(synch),
@@ -41,7 +45,7 @@ GSMServer::GSMServer(uint16_t port, bool synch) :
     _childSockets[i].available = 0;
   }
 
-  MODEM.addUrcHandler(this);
+  MODEM.addUrcHandler(this, URC_PREFIXES);
 }
 
 GSMServer::~GSMServer()
@@ -223,10 +227,13 @@ void GSMServer::stop()
   _socket = -1;
 }
 
-void GSMServer::handleUrc(const String& urc)
+void GSMServer::handleUrc(const ModemLine& urc)
 {
-  if (urc.startsWith("+UUSOLI: ")) {
-    int socket = urc.charAt(9) - '0';
+  if (urc.is("+UUSOLI")) {
+    int socket = urc.fieldInt(0);
+
+    // the modem reuses socket numbers, forget what the last one left behind
+    GSMSocketBuffer.close(socket);
 
     for (int i = 0; i < MAX_CHILD_SOCKETS; i++) {
       if (_childSockets[i].socket == -1) {
@@ -237,8 +244,8 @@ void GSMServer::handleUrc(const String& urc)
         break;
       }
     }
-  } else if (urc.startsWith("+UUSOCL: ")) {
-    int socket = urc.charAt(urc.length() - 1) - '0';
+  } else if (urc.is("+UUSOCL")) {
+    int socket = urc.fieldInt(0);
 
     if (socket == _socket) {
       _socket = -1;
@@ -253,14 +260,13 @@ void GSMServer::handleUrc(const String& urc)
         }
       }
     }
-  } else if (urc.startsWith("+UUSORD: ")) {
-    int socket = urc.charAt(9) - '0';
+  } else if (urc.is("+UUSORD")) {
+    int socket = urc.fieldInt(0);
 
     for (int i = 0; i < MAX_CHILD_SOCKETS; i++) {
       if (_childSockets[i].socket == socket) {
-        int commaIndex = urc.indexOf(',');
-        if (commaIndex != -1) {
-          _childSockets[i].available = urc.substring(commaIndex + 1).toInt();
+        if (urc.fields() > 1) {
+          _childSockets[i].available = urc.fieldInt(1);
         }
 
         break;
@@ -89,7 +89,7 @@ public:
    */
   void stop();
 
-  virtual void handleUrc(const String& urc);
+  virtual void handleUrc(const ModemLine& urc);
 
 private:
   uint16_t _port;
@@ -19,8 +19,12 @@
 
 #include <Modem.h>
 
+#include "utility/GSMHex.h"
+
 #include "GSMUdp.h"
 
+static const char* const URC_PREFIXES[] = { "+UUSORF", "+UUSOCL", NULL };
+
 GSMUDP::GSMUDP() :
   _socket(-1),
   _packetReceived(false),
@@ -33,7 +37,7 @@ GSMUDP::GSMUDP() :
   _rxSize(0),
   _rxIndex(0)
 {
-  MODEM.addUrcHandler(this);
+  MODEM.addUrcHandler(this, URC_PREFIXES);
 }
 
 GSMUDP::~GSMUDP()
@@ -106,6 +110,10 @@ int GSMUDP::endPacket()
 {
   String command;
 
+  if (!MODEM.setHexMode(true)) {
+    return 0;
+  }
+
   if (_txHost != NULL) {
     command.reserve(26 + strlen(_txHost) + _txSize * 2);
   } else {
@@ -133,17 +141,7 @@ int GSMUDP::endPacket()
   command += ",",
   command += _txSize;
   command += ",\"";
-
-  for (size_t i = 0; i < _txSize; i++) {
-    byte b = _txBuffer[i];
-
-    byte n1 = (b >> 4) & 0x0f;
-    byte n2 = (b & 0x0f);
-
-    command += (char)(n1 > 9 ? 'A' + n1 - 10 : '0' + n1);
-    command += (char)(n2 > 9 ? 'A' + n2 - 10 : '0' + n2);
-  }
-
+  GSMHex::encode(_txBuffer, _txSize, command);
   command += "\"";
 
   MODEM.send(command);
@@ -178,6 +176,23 @@ size_t GSMUDP::write(const uint8_t *buffer, size_t size)
   return size;
 }
 
+size_t GSMUDP::writev(const ModemSegment* segments, int count)
+{
+  size_t written = 0;
+
+  for (int i = 0; i < count; i++) {
+    size_t n = write(segments[i].data, segments[i].size);
+
+    written += n;
+
+    if (n < segments[i].size) {
+      break;
+    }
+  }
+
+  return written;
+}
+
 int GSMUDP::parsePacket()
 {
   MODEM.poll();
@@ -193,61 +208,42 @@ int GSMUDP::parsePacket()
 
   String response;
 
-  MODEM.sendf("AT+USORF=%d,%d", _socket, sizeof(_rxBuffer));
-  if (MODEM.waitForResponse(10000, &response) != 1) {
+  if (!MODEM.setHexMode(true)) {
     return 0;
   }
 
-  if (!response.startsWith("+USORF: ")) {
-    return 0;
-  }
-
-  response.remove(0, 11);
-
-  int firstQuoteIndex = response.indexOf('"');
-  if (firstQuoteIndex == -1) {
+  MODEM.sendf("AT+USORF=%d,%d", _socket, sizeof(_rxBuffer));
+  if (MODEM.waitForResponse(10000, &response) != 1) {
     return 0;
   }
 
-  String ip = response.substring(0, firstQuoteIndex);
-  _rxIp.fromString(ip);
+  // +USORF: <socket>,"<ip>",<port>,<length>,"<data>"
+  ModemLine line(response);
 
-  response.remove(0, firstQuoteIndex + 2);
-
-  int firstCommaIndex = response.indexOf(',');
-  if (firstCommaIndex == -1) {
+  if (!line.is("+USORF") || line.fields() < 5) {
     return 0;
   }
 
-  String port = response.substring(0, firstCommaIndex);
-  _rxPort = port.toInt();
-  firstQuoteIndex = response.indexOf("\"");
-
-  response.remove(0, firstQuoteIndex + 1);
-  response.remove(response.length() - 1);
+  _rxIp.fromString(line.fieldString(1));
+  _rxPort = line.fieldInt(2);
 
   _rxIndex = 0;
-  _rxSize = response.length() / 2;
+  _rxSize = 0;
 
-  for (size_t i = 0; i < _rxSize; i++) {
-    byte n1 = response[i * 2];
-    byte n2 = response[i * 2 + 1];
+  size_t length;
+  const char* data = line.field(4, &length);
 
-    if (n1 > '9') {
-      n1 = (n1 - 'A') + 10;
-    } else {
-      n1 = (n1 - '0');
-    }
-
-    if (n2 > '9') {
-      n2 = (n2 - 'A') + 10;
-    } else {
-      n2 = (n2 - '0');
-    }
+  if (length > sizeof(_rxBuffer) * 2) {
+    return 0;
+  }
 
-    _rxBuffer[i] = (n1 << 4) | n2;
+  int size = GSMHex::decode(data, length, _rxBuffer);
+  if (size < 0) {
+    return 0;
   }
 
+  _rxSize = size;
+
   MODEM.poll();
 
   return _rxSize;
@@ -311,16 +307,16 @@ uint16_t GSMUDP::remotePort()
   return _rxPort;
 }
 
-void GSMUDP::handleUrc(const String& urc)
+void GSMUDP::handleUrc(const ModemLine& urc)
 {
-  if (urc.startsWith("+UUSORF: ")) {
-    int socket = urc.charAt(9) - '0';
+  if (urc.is("+UUSORF")) {
+    int socket = urc.fieldInt(0);
 
     if (socket == _socket) {
       _packetReceived = true;
     }
-  } else if (urc.startsWith("+UUSOCL: ")) {
-    int socket = urc.charAt(urc.length() - 1) - '0';
+  } else if (urc.is("+UUSOCL")) {
+    int socket = urc.fieldInt(0);
 
     if (socket == _socket) {
       // this socket closed
@@ -48,6 +48,8 @@ public:
   virtual size_t write(uint8_t);
   // Write size bytes from buffer into the packet
   virtual size_t write(const uint8_t *buffer, size_t size);
+  // Write several buffers into the packet, in order
+  size_t writev(const ModemSegment* segments, int count);
 
   using Print::write;
 
@@ -73,7 +75,7 @@ public:
   // Return the port of the host who sent the current incoming packet
   virtual uint16_t remotePort();
 
-  virtual void handleUrc(const String& urc);
+  virtual void handleUrc(const ModemLine& urc);
 
 private:
   int _socket;
@@ -19,11 +19,13 @@
 
 #include "GSMVoiceCall.h"
 
+static const char* const URC_PREFIXES[] = { "+UCALLSTAT", "+UUDTMFD", NULL };
+
 GSMVoiceCall::GSMVoiceCall(bool synch) :
   _synch(synch),
   _callStatus(IDLE_CALL)
 {
-  MODEM.addUrcHandler(this);
+  MODEM.addUrcHandler(this, URC_PREFIXES);
 }
 
 GSMVoiceCall::~GSMVoiceCall()
@@ -304,10 +306,10 @@ int GSMVoiceCall::disableI2SInput()
   return 0;
 }
 
-void GSMVoiceCall::handleUrc(const String& urc)
+void GSMVoiceCall::handleUrc(const ModemLine& urc)
 {
-  if (urc.startsWith("+UCALLSTAT: ")) {
-    int status = urc.charAt(urc.length() - 1) - '0';
+  if (urc.is("+UCALLSTAT")) {
+    int status = urc.fieldInt(urc.fields() - 1);
 
     if (status == 0 || status == 1 || status == 7) {
       _callStatus = TALKING;
@@ -319,7 +321,12 @@ void GSMVoiceCall::handleUrc(const String& urc)
     } else {
       _callStatus = IDLE_CALL;
     }
-  } else if (urc.startsWith("+UUDTMFD: ")) {
-    _dtmfBuffer += urc.charAt(10);
+  } else if (urc.is("+UUDTMFD")) {
+    size_t length;
+    const char* dtmf = urc.field(0, &length);
+
+    if (length) {
+      _dtmfBuffer += *dtmf;
+    }
   }
 }
@@ -84,7 +84,7 @@ public:
   int enableI2SInput(long sampleRate);
   int disableI2SInput();
 
-  virtual void handleUrc(const String& urc);
+  virtual void handleUrc(const ModemLine& urc);
 private:
   int _synch;
   GSM3_voiceCall_st _callStatus;
@@ -19,27 +19,115 @@
 
 #include "Modem.h"
 
-#define MODEM_MIN_RESPONSE_OR_URC_WAIT_TIME_MS 20
+#define MODEM_DEFAULT_GUARD_TIME_MS 20
+
+#ifdef SERIAL_BUFFER_SIZE
+#define MODEM_UART_RX_BUFFER_SIZE SERIAL_BUFFER_SIZE
+#else
+#define MODEM_UART_RX_BUFFER_SIZE 256
+#endif
+
+ModemUrcHandler* ModemClass::_urcHandlers = NULL;
+unsigned long ModemClass::_urcHandlersRejected = 0;
+
+ModemUrcHandler::ModemUrcHandler(const ModemUrcHandler& other) :
+  _urcNext(NULL),
+  _urcPrev(NULL),
+  _urcMask(other._urcMask),
+  _urcRegistered(false)
+{
+  // a copy of a registered handler (like a GSMClient returned by value)
+  // wants the same URCs as the original
+  if (other._urcRegistered) {
+    ModemClass::linkUrcHandler(this);
+  }
+}
+
+ModemUrcHandler::~ModemUrcHandler()
+{
+  MODEM.removeUrcHandler(this);
+}
+
+ModemUrcHandler& ModemUrcHandler::operator=(const ModemUrcHandler& /*other*/)
+{
+  // keep our own place in the handler list
+  return *this;
+}
+
+void ModemUrcHandler::handleUrc(const ModemLine& urc)
+{
+  String line;
+
+  line.reserve(urc.length());
+  for (size_t i = 0; i < urc.length(); i++) {
+    line += urc.data()[i];
+  }
 
-ModemUrcHandler* ModemClass::_urcHandlers[MAX_URC_HANDLERS] = { NULL };
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+  handleUrc(line);
+#pragma GCC diagnostic pop
+}
+
+void ModemUrcHandler::handleUrc(const String& /*urc*/)
+{
+}
+
+ModemPollHandler::~ModemPollHandler()
+{
+  MODEM.removePollHandler(this);
+}
 Print* ModemClass::_debugPrint = NULL;
 
-ModemClass::ModemClass(Uart& uart, unsigned long baud, int resetPin, int dtrPin) :
+ModemClass::ModemClass(HardwareSerial& uart, unsigned long baud, int resetPin, int dtrPin) :
   _uart(&uart),
   _baud(baud),
+  _baudRateErrors(0),
   _resetPin(resetPin),
   _dtrPin(dtrPin),
   _lowPowerMode(false),
+  _flowControl(-1),
   _lastResponseOrUrcMillis(0),
+  _guardTime(MODEM_DEFAULT_GUARD_TIME_MS),
+  _guardTimeWaited(0),
   _atCommandState(AT_COMMAND_IDLE),
   _ready(1),
-  _responseDataStorage(NULL)
+  _lineLength(0),
+  _lineOverflow(false),
+  _lineIsEcho(false),
+  _responseDataStorage(NULL),
+  _responseDataSink(NULL),
+  _rxBuffer(NULL),
+  _rxBufferSize(0),
+  _rxHead(0),
+  _rxTail(0),
+  _rxServicing(false),
+  _rxOverflows(0),
+  _stats(NULL),
+  _trace(NULL),
+  _binaryData(NULL),
+  _binaryDataSize(0),
+  _binaryDataIndex(0),
+  _binaryDataRemaining(0),
+  _hexMode(1),
+  _backgroundHead(0),
+  _backgroundCount(0),
+  _backgroundSent(false),
+  _sending(false),
+  _abandoned(false),
+  _pollHandlers(NULL),
+  _pollingHandlers(false),
+  _yieldCallback(NULL),
+  _yieldContext(NULL),
+  _yielding(false)
 {
   _buffer.reserve(64);
 }
 
 int ModemClass::begin(bool restart)
 {
+  // GSM::ready() puts the modem in hex mode (AT+UDCONF=1,1)
+  _hexMode = 1;
   _uart->begin(_baud > 115200 ? 115200 : _baud);
 
   if (_resetPin > -1 && restart) {
@@ -65,17 +153,16 @@ int ModemClass::begin(bool restart)
     return 0;
   }
 
-  if (_baud > 115200) {
-    sendf("AT+IPR=%ld", _baud);
+  if (_flowControl != -1) {
+    // set before the switch to a higher rate, so it is protected right away
+    sendf("AT+IFC=%d,%d", _flowControl ? 2 : 0, _flowControl ? 2 : 0);
     if (waitForResponse() != 1) {
       return 0;
     }
+  }
 
-    _uart->end();
-    delay(100);
-    _uart->begin(_baud);
-
-    if (!autosense()) {
+  if (_baud > 115200) {
+    if (!switchBaudRate(_baud, 10000)) {
       return 0;
     }
   }
@@ -93,6 +180,30 @@ int ModemClass::begin(bool restart)
   return 1;
 }
 
+int ModemClass::setFlowControl(bool enable)
+{
+#ifdef PIN_SERIALGSM_RTS
+  _flowControl = enable;
+
+  return 1;
+#else
+  // without RTS/CTS on the SerialGSM side the modem would stall
+  // waiting for RTS, so only disabling it is possible
+  if (enable) {
+    return 0;
+  }
+
+  _flowControl = 0;
+
+  return 1;
+#endif
+}
+
+int ModemClass::flowControl()
+{
+  return (_flowControl == 1);
+}
+
 void ModemClass::end()
 {
   _uart->end();
@@ -178,6 +289,14 @@ size_t ModemClass::write(uint8_t c)
 
 size_t ModemClass::write(const uint8_t* buf, size_t size)
 {
+  if (_stats != NULL) {
+    _stats->bytesSent(size);
+  }
+
+  if (_trace != NULL) {
+    _trace->record(ModemTrace::TX_DATA, (const char*)buf, size);
+  }
+
   return _uart->write(buf, size);
 }
 
@@ -188,17 +307,39 @@ void ModemClass::send(const char* command)
     delay(5);
   }
 
-  // compare the time of the last response or URC and ensure 
-  // at least 20ms have passed before sending a new command
+  waitForBackground();
+
+  // the yield callback may poll() during the guard time, which must
+  // not slip a queued background command in ahead of this one
+  _sending = true;
+
+  // the modem needs a guard time after the last response or URC
+  // before it accepts a new command
   unsigned long delta = millis() - _lastResponseOrUrcMillis;
-  if(delta < MODEM_MIN_RESPONSE_OR_URC_WAIT_TIME_MS) {
-    delay(MODEM_MIN_RESPONSE_OR_URC_WAIT_TIME_MS - delta);
+  if (delta < _guardTime) {
+    for (unsigned long end = deadline(_guardTime - delta); !expired(end);) {
+      idle();
+    }
+
+    _guardTimeWaited += _guardTime - delta;
+  }
+
+  if (_stats != NULL) {
+    _stats->commandSent(command, strlen(command) + 2);
+  }
+
+  if (_trace != NULL) {
+    _trace->record(ModemTrace::TX, command, strlen(command));
   }
 
   _uart->println(command);
   _uart->flush();
   _atCommandState = AT_COMMAND_IDLE;
   _ready = 0;
+  _buffer = "";
+
+  _sending = false;
+  _abandoned = false;
 }
 
 void ModemClass::sendf(const char *fmt, ...)
@@ -214,31 +355,74 @@ void ModemClass::sendf(const char *fmt, ...)
 }
 
 int ModemClass::waitForResponse(unsigned long timeout, String* responseDataStorage)
+{
+  return waitForResponseUntil(deadline(timeout), responseDataStorage);
+}
+
+int ModemClass::waitForResponseUntil(unsigned long deadline, String* responseDataStorage)
 {
   _responseDataStorage = responseDataStorage;
-  for (unsigned long start = millis(); (millis() - start) < timeout;) {
+  do {
     int r = ready();
 
     if (r != 0) {
       _responseDataStorage = NULL;
+      _responseDataSink = NULL;
+      _binaryData = NULL;
       return r;
     }
-  }
+
+    idle();
+  } while (!expired(deadline));
 
   _responseDataStorage = NULL;
+  _responseDataSink = NULL;
+  _binaryData = NULL;
+  _binaryDataRemaining = 0;
+
+  if (_stats != NULL) {
+    _stats->commandCompleted(-1);
+  }
+
+  if (_trace != NULL) {
+    _trace->record(ModemTrace::TIMEOUT, NULL, 0);
+  }
+
   _buffer = "";
+  _lineLength = 0;
+  _lineOverflow = false;
+
+  // nobody waits for this command anymore, poll() fails the queued
+  // background commands instead of holding them until it completes
+  _abandoned = true;
   return -1;
 }
 
-int ModemClass::waitForPrompt(unsigned long timeout)
+int ModemClass::waitForResponse(unsigned long timeout, Print& responseDataSink)
 {
-  for (unsigned long start = millis(); (millis() - start) < timeout;) {
+  _responseDataSink = &responseDataSink;
+
+  return waitForResponse(timeout);
+}
+
+int ModemClass::waitForPrompt(unsigned long timeout, char prompt)
+{
+  return waitForPromptUntil(deadline(timeout), prompt);
+}
+
+int ModemClass::waitForPromptUntil(unsigned long deadline, char prompt)
+{
+  do {
     ready();
 
-    if (_buffer.endsWith(">")) {
+    if (_lineLength && _lineBuffer[_lineLength - 1] == prompt) {
+      // consume the prompt, what follows is the command response
+      _lineLength = 0;
       return 1;
     }
-  }
+
+    idle();
+  } while (!expired(deadline));
 
   return -1;
 }
@@ -252,108 +436,669 @@ int ModemClass::ready()
 
 void ModemClass::poll()
 {
-  while (_uart->available()) {
-    char c = _uart->read();
+  int rx;
+
+  serviceRx();
+
+  while ((rx = readRx()) != -1) {
+    char c = rx;
+
+    if (_stats != NULL) {
+      _stats->bytesReceived(1);
+    }
 
     if (_debugPrint) {
       _debugPrint->write(c);
     }
 
-    _buffer += c;
+    if (_binaryDataRemaining) {
+      // raw payload of a binary mode response, bypasses the line buffer
+      if (_binaryDataIndex < _binaryDataSize) {
+        _binaryData[_binaryDataIndex++] = c;
+      }
 
-    switch (_atCommandState) {
-      case AT_COMMAND_IDLE:
-      default: {
+      if (--_binaryDataRemaining == 0) {
+        _binaryData = NULL;
+      }
+      continue;
+    }
 
-        if (_buffer.startsWith("AT") && _buffer.endsWith("\r\n")) {
-          _atCommandState = AT_RECEIVING_RESPONSE;
-          _buffer = "";
-        }  else if (_buffer.endsWith("\r\n")) {
-          _buffer.trim();
+    if (_lineLength == MODEM_LINE_BUFFER_SIZE) {
+      // line is longer than the line buffer, only response data can be this
+      // long: move what we have so far to the response and keep going
+      if (!_lineOverflow) {
+        _lineIsEcho = (_lineBuffer[0] == 'A' && _lineBuffer[1] == 'T');
+        _lineOverflow = true;
+      }
 
-          if (_buffer.length()) {
-            _lastResponseOrUrcMillis = millis();
+      if (_atCommandState == AT_RECEIVING_RESPONSE) {
+        _lineBuffer[_lineLength] = '\0';
+        appendResponse();
 
-            for (int i = 0; i < MAX_URC_HANDLERS; i++) {
-              if (_urcHandlers[i] != NULL) {
-                _urcHandlers[i]->handleUrc(_buffer);
-              }
-            }
-          }
+        if (_trace != NULL) {
+          _trace->record(ModemTrace::RX, _lineBuffer, _lineLength);
+        }
+      }
+
+      _lineLength = 0;
+    }
 
-          _buffer = "";
+    _lineBuffer[_lineLength++] = c;
+
+    if (c == '"' && _binaryData != NULL && _atCommandState == AT_RECEIVING_RESPONSE) {
+      // a quote after ",<length>," starts a raw payload of <length> bytes
+      size_t i = _lineLength - 1;
+      size_t length = 0;
+      size_t multiplier = 1;
+
+      if (i > 0 && _lineBuffer[--i] == ',') {
+        while (i > 0 && _lineBuffer[i - 1] >= '0' && _lineBuffer[i - 1] <= '9') {
+          length += (_lineBuffer[--i] - '0') * multiplier;
+          multiplier *= 10;
         }
 
-        break;
+        if (multiplier > 1 && i > 0 && _lineBuffer[i - 1] == ',') {
+          _binaryDataIndex = 0;
+          _binaryDataRemaining = length;
+
+          if (length == 0) {
+            _binaryData = NULL;
+          }
+        }
       }
+      continue;
+    }
+
+    if (c != '\n') {
+      continue;
+    }
+
+    _lineBuffer[_lineLength] = '\0';
+
+    bool responseComplete = handleLine();
+
+    _lineLength = 0;
+    _lineOverflow = false;
 
-      case AT_RECEIVING_RESPONSE: {
-        if (c == '\n') {
+    if (responseComplete) {
+      return;
+    }
+  }
+
+  if (_backgroundSent && (millis() - _backgroundStart) >= _backgroundQueue[_backgroundHead].timeout) {
+    _atCommandState = AT_COMMAND_IDLE;
+    _responseDataStorage = NULL;
+    _binaryData = NULL;
+    _binaryDataRemaining = 0;
+    _buffer = "";
+
+    if (_stats != NULL) {
+      _stats->commandCompleted(-1);
+    }
+
+    if (_trace != NULL) {
+      _trace->record(ModemTrace::TIMEOUT, NULL, 0);
+    }
+
+    completeBackground(-1);
+  }
+
+  // queued commands wait for the regular command to complete, but not once
+  // it was abandoned or for longer than their own timeout, the ones the
+  // callbacks queue meanwhile are left for the next poll()
+  for (int queued = _backgroundCount; queued > 0 && _backgroundCount > 0 && !_backgroundSent && _ready == 0 && !_sending; queued--) {
+    if (!_abandoned && (millis() - _backgroundQueue[_backgroundHead].queued) < _backgroundQueue[_backgroundHead].timeout) {
+      break;
+    }
+
+    dropBackground();
+  }
+
+  if (!_backgroundSent && _backgroundCount > 0 && _ready != 0 && !_sending) {
+    sendBackground();
+  }
+
+  if (_pollHandlers != NULL && !_pollingHandlers) {
+    _pollingHandlers = true;
+
+    for (ModemPollHandler* handler = _pollHandlers; handler != NULL;) {
+      // the handler may remove itself
+      ModemPollHandler* next = handler->_pollNext;
+
+      handler->handlePoll();
+      handler = next;
+    }
+
+    _pollingHandlers = false;
+  }
+}
+
+bool ModemClass::handleLine()
+{
+  switch (_atCommandState) {
+    case AT_COMMAND_IDLE:
+    default: {
+      bool echo = _lineOverflow ? _lineIsEcho : (_lineBuffer[0] == 'A' && _lineBuffer[1] == 'T');
+
+      if (echo) {
+        _atCommandState = AT_RECEIVING_RESPONSE;
+        _buffer = "";
+      } else if (!_lineOverflow) {
+        ModemLine urc(_lineBuffer, _lineLength);
+
+        if (urc.length()) {
           _lastResponseOrUrcMillis = millis();
 
-          int responseResultIndex = _buffer.lastIndexOf("OK\r\n");
-          if (responseResultIndex != -1) {
-            _ready = 1;
-          } else {
-            responseResultIndex = _buffer.lastIndexOf("ERROR\r\n");
-            if (responseResultIndex != -1) {
-              _ready = 2;
-            } else {
-              responseResultIndex = _buffer.lastIndexOf("NO CARRIER\r\n");
-              if (responseResultIndex != -1) {
-                _ready = 3;
-              }
-            }
+          if (_trace != NULL) {
+            _trace->record(ModemTrace::URC, urc.data(), urc.length());
           }
 
-          if (_ready != 0) {
-            if (_lowPowerMode) {
-              digitalWrite(_dtrPin, HIGH);
-            }
+          dispatchUrc(urc);
+        }
+      }
 
-            if (_responseDataStorage != NULL) {
-              _buffer.remove(responseResultIndex);
-              _buffer.trim();
+      break;
+    }
 
-              *_responseDataStorage = _buffer;
+    case AT_RECEIVING_RESPONSE: {
+      _lastResponseOrUrcMillis = millis();
 
-              _responseDataStorage = NULL;
-            }
+      if (_trace != NULL) {
+        bool urc = !_lineOverflow && strncmp(_lineBuffer, "+UU", 3) == 0;
 
-            _atCommandState = AT_COMMAND_IDLE;
-            _buffer = "";
-            return;
-          }
+        _trace->record(urc ? ModemTrace::URC : ModemTrace::RX, _lineBuffer, _lineLength);
+      }
+
+      // only the line that just completed can hold the final result code
+      if (!_lineOverflow) {
+        if (strcmp(_lineBuffer, "OK\r\n") == 0) {
+          _ready = 1;
+        } else if (strcmp(_lineBuffer, "ERROR\r\n") == 0) {
+          _ready = 2;
+        } else if (strcmp(_lineBuffer, "NO CARRIER\r\n") == 0) {
+          _ready = 3;
+        }
+      }
+
+      if (_ready == 0) {
+        if (!_lineOverflow && strncmp(_lineBuffer, "+UU", 3) == 0) {
+          // no command response starts with +UU, so this is a URC (like
+          // +UUSORD) that arrived in the middle of a response, don't lose it
+          dispatchUrc(ModemLine(_lineBuffer, _lineLength));
+        } else {
+          appendResponse();
         }
         break;
       }
+
+      if (_stats != NULL) {
+        _stats->commandCompleted(_ready);
+      }
+
+      if (_lowPowerMode) {
+        digitalWrite(_dtrPin, HIGH);
+      }
+
+      _responseDataSink = NULL;
+
+      if (_responseDataStorage != NULL) {
+        _buffer.trim();
+
+        *_responseDataStorage = _buffer;
+
+        _responseDataStorage = NULL;
+      }
+
+      _atCommandState = AT_COMMAND_IDLE;
+      _buffer = "";
+
+      if (_backgroundSent) {
+        completeBackground(_ready);
+      }
+      return true;
+    }
+  }
+
+  return false;
+}
+
+uint32_t ModemClass::urcMask(const char* name, size_t length)
+{
+  // FNV-1a, folded to one of 32 bits
+  uint32_t hash = 2166136261UL;
+
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ (uint8_t)name[i]) * 16777619UL;
+  }
+
+  return 1UL << ((hash ^ (hash >> 5) ^ (hash >> 10)) & 31);
+}
+
+void ModemClass::dispatchUrc(const ModemLine& urc)
+{
+  uint32_t mask = urcMask(urc.data(), urc.nameLength());
+
+  ModemUrcHandler* handler = _urcHandlers;
+
+  while (handler != NULL) {
+    // the handler might remove itself
+    ModemUrcHandler* next = handler->_urcNext;
+
+    if (handler->_urcMask & mask) {
+      handler->handleUrc(urc);
     }
+
+    handler = next;
   }
 }
 
 void ModemClass::setResponseDataStorage(String* responseDataStorage)
 {
+  waitForBackground();
+
   _responseDataStorage = responseDataStorage;
 }
 
-void ModemClass::addUrcHandler(ModemUrcHandler* handler)
+void ModemClass::setStats(ModemStats* stats)
 {
-  for (int i = 0; i < MAX_URC_HANDLERS; i++) {
-    if (_urcHandlers[i] == NULL) {
-      _urcHandlers[i] = handler;
-      break;
+  _stats = stats;
+}
+
+void ModemClass::setTrace(ModemTrace* trace)
+{
+  _trace = trace;
+}
+
+void ModemClass::setRxBuffer(uint8_t* buffer, size_t size)
+{
+  _rxServicing = true;
+
+  _rxBuffer = buffer;
+  _rxBufferSize = size;
+  _rxHead = _rxTail = 0;
+
+  _rxServicing = false;
+}
+
+void ModemClass::serviceRx()
+{
+  // called from the sketch and possibly a timer interrupt, the
+  // interrupt simply skips the service if it hit the sketch in here
+  if (_rxServicing) {
+    return;
+  }
+
+  _rxServicing = true;
+
+  int available = _uart->available();
+
+  if (available >= (MODEM_UART_RX_BUFFER_SIZE - 1)) {
+    // the UART ring is full, bytes have likely been dropped
+    _rxOverflows++;
+  }
+
+  if (_rxBuffer != NULL) {
+    while (available--) {
+      size_t next = (_rxHead + 1) % _rxBufferSize;
+
+      if (next == _rxTail) {
+        // the rest stays in the UART until there is room
+        break;
+      }
+
+      _rxBuffer[_rxHead] = _uart->read();
+      _rxHead = next;
     }
   }
+
+  _rxServicing = false;
 }
 
-void ModemClass::removeUrcHandler(ModemUrcHandler* handler)
+unsigned long ModemClass::rxOverflows()
 {
-  for (int i = 0; i < MAX_URC_HANDLERS; i++) {
-    if (_urcHandlers[i] == handler) {
-      _urcHandlers[i] = NULL;
-      break;
+  return _rxOverflows;
+}
+
+int ModemClass::readRx()
+{
+  if (_rxBuffer == NULL) {
+    return _uart->available() ? _uart->read() : -1;
+  }
+
+  if (_rxHead == _rxTail) {
+    serviceRx();
+
+    if (_rxHead == _rxTail) {
+      return -1;
     }
   }
+
+  uint8_t c = _rxBuffer[_rxTail];
+
+  _rxTail = (_rxTail + 1) % _rxBufferSize;
+
+  return c;
+}
+
+void ModemClass::setResponseDataSink(Print* responseDataSink)
+{
+  waitForBackground();
+
+  _responseDataSink = responseDataSink;
+}
+
+void ModemClass::appendResponse()
+{
+  if (_responseDataSink != NULL) {
+    _responseDataSink->write((const uint8_t*)_lineBuffer, _lineLength);
+  } else {
+    _buffer += _lineBuffer;
+  }
+}
+
+void ModemClass::setBinaryDataStorage(uint8_t* data, size_t size)
+{
+  waitForBackground();
+
+  _binaryData = data;
+  _binaryDataSize = size;
+  _binaryDataIndex = 0;
+  _binaryDataRemaining = 0;
+}
+
+int ModemClass::sendBackground(const char* command, unsigned long timeout, ModemResponseCallback callback, void* context,
+                                String* responseDataStorage, uint8_t* binaryData, size_t binaryDataSize)
+{
+  if (_backgroundCount == MODEM_BACKGROUND_QUEUE_SIZE) {
+    return 0;
+  }
+
+  int index = (_backgroundHead + _backgroundCount) % MODEM_BACKGROUND_QUEUE_SIZE;
+
+  _backgroundQueue[index].command = command;
+  _backgroundQueue[index].timeout = timeout;
+  _backgroundQueue[index].queued = millis();
+  _backgroundQueue[index].callback = callback;
+  _backgroundQueue[index].context = context;
+  _backgroundQueue[index].responseDataStorage = responseDataStorage;
+  _backgroundQueue[index].binaryData = binaryData;
+  _backgroundQueue[index].binaryDataSize = binaryDataSize;
+  _backgroundCount++;
+
+  return 1;
+}
+
+int ModemClass::backgroundAvailable()
+{
+  return MODEM_BACKGROUND_QUEUE_SIZE - _backgroundCount;
+}
+
+void ModemClass::cancelBackground(void* context)
+{
+  // the callbacks of an object that goes away must not run anymore: its
+  // unsent commands are dropped, a sent one completes without a callback
+  int kept = 0;
+
+  for (int i = 0; i < _backgroundCount; i++) {
+    int index = (_backgroundHead + i) % MODEM_BACKGROUND_QUEUE_SIZE;
+
+    if (_backgroundQueue[index].context == context) {
+      if (i > 0 || !_backgroundSent) {
+        continue;
+      }
+
+      _backgroundQueue[index].callback = NULL;
+      _backgroundQueue[index].context = NULL;
+      _responseDataStorage = NULL;
+      _binaryData = NULL;
+      _binaryDataSize = 0;
+    }
+
+    if (kept != i) {
+      _backgroundQueue[(_backgroundHead + kept) % MODEM_BACKGROUND_QUEUE_SIZE] = _backgroundQueue[index];
+    }
+    kept++;
+  }
+
+  _backgroundCount = kept;
+}
+
+void ModemClass::sendBackground()
+{
+  // a background command must not disturb the result of the
+  // last regular command, it is restored once the command completes
+  _backgroundReady = _ready;
+
+  send(_backgroundQueue[_backgroundHead].command);
+
+  _responseDataStorage = _backgroundQueue[_backgroundHead].responseDataStorage;
+  if (_backgroundQueue[_backgroundHead].binaryData != NULL) {
+    setBinaryDataStorage(_backgroundQueue[_backgroundHead].binaryData, _backgroundQueue[_backgroundHead].binaryDataSize);
+  }
+
+  _backgroundSent = true;
+  _backgroundStart = millis();
+}
+
+void ModemClass::waitForBackground()
+{
+  // a command sent in the background owns the response, let it complete first
+  while (_backgroundSent) {
+    poll();
+
+    if (_backgroundSent) {
+      idle();
+    }
+  }
+}
+
+void ModemClass::drainBackground()
+{
+  while (_backgroundCount > 0) {
+    if (!_backgroundSent && _ready == 0) {
+      // a regular command nobody waits for holds the modem, the queued
+      // commands can't run before the mode changes, fail them instead
+      dropBackground();
+      continue;
+    }
+
+    poll();
+
+    if (_backgroundCount > 0) {
+      idle();
+    }
+  }
+}
+
+void ModemClass::dropBackground()
+{
+  // fail the oldest queued command without sending it
+  ModemResponseCallback callback = _backgroundQueue[_backgroundHead].callback;
+  void* context = _backgroundQueue[_backgroundHead].context;
+
+  _backgroundHead = (_backgroundHead + 1) % MODEM_BACKGROUND_QUEUE_SIZE;
+  _backgroundCount--;
+
+  if (callback != NULL) {
+    callback(-1, context);
+  }
+}
+
+void ModemClass::completeBackground(int status)
+{
+  ModemResponseCallback callback = _backgroundQueue[_backgroundHead].callback;
+  void* context = _backgroundQueue[_backgroundHead].context;
+
+  _backgroundHead = (_backgroundHead + 1) % MODEM_BACKGROUND_QUEUE_SIZE;
+  _backgroundCount--;
+  _backgroundSent = false;
+  _ready = _backgroundReady;
+
+  if (callback != NULL) {
+    callback(status, context);
+  }
+}
+
+void ModemClass::setGuardTime(unsigned long guardTime)
+{
+  _guardTime = guardTime;
+}
+
+unsigned long ModemClass::guardTimeWaited()
+{
+  return _guardTimeWaited;
+}
+
+void ModemClass::setYieldCallback(ModemYieldCallback callback, void* context)
+{
+  _yieldCallback = callback;
+  _yieldContext = context;
+}
+
+unsigned long ModemClass::deadline(unsigned long timeout)
+{
+  return millis() + timeout;
+}
+
+bool ModemClass::expired(unsigned long deadline)
+{
+  // signed difference, so the comparison survives millis() wrapping around
+  return (long)(millis() - deadline) >= 0;
+}
+
+void ModemClass::idle(unsigned long duration)
+{
+  // called while blocked on the modem, the callback may poll() but must not
+  // send commands of its own and is not reentered
+  if (_yieldCallback == NULL || _yielding) {
+    delay(duration);
+    return;
+  }
+
+  unsigned long end = deadline(duration);
+
+  _yielding = true;
+  do {
+    _yieldCallback(_yieldContext);
+  } while (!expired(end));
+  _yielding = false;
+}
+
+int ModemClass::setHexMode(bool enable)
+{
+  if (_hexMode == enable) {
+    return 1;
+  }
+
+  // queued background reads and writes were built for the current mode, let
+  // them run before it changes, -1 keeps new ones from being queued meanwhile
+  _hexMode = -1;
+  drainBackground();
+
+  // AT+UDCONF=1 is modem wide, so only send it when the mode changes
+  sendf("AT+UDCONF=1,%d", enable ? 1 : 0);
+  if (waitForResponse() != 1) {
+    _hexMode = -1;
+    return 0;
+  }
+
+  _hexMode = enable;
+
+  return 1;
+}
+
+int ModemClass::hexMode()
+{
+  return _hexMode;
+}
+
+void ModemClass::addUrcHandler(ModemUrcHandler* handler, const char* const* prefixes)
+{
+  uint32_t mask = 0xffffffff;
+
+  if (prefixes != NULL) {
+    mask = 0;
+
+    while (*prefixes != NULL) {
+      mask |= urcMask(*prefixes, strlen(*prefixes));
+      prefixes++;
+    }
+  }
+
+  if (handler->_urcRegistered) {
+    _urcHandlersRejected++;
+    return;
+  }
+
+  handler->_urcMask = mask;
+
+  linkUrcHandler(handler);
+}
+
+void ModemClass::removeUrcHandler(ModemUrcHandler* handler)
+{
+  if (!handler->_urcRegistered) {
+    return;
+  }
+
+  if (handler->_urcPrev != NULL) {
+    handler->_urcPrev->_urcNext = handler->_urcNext;
+  } else {
+    _urcHandlers = handler->_urcNext;
+  }
+
+  if (handler->_urcNext != NULL) {
+    handler->_urcNext->_urcPrev = handler->_urcPrev;
+  }
+
+  handler->_urcNext = handler->_urcPrev = NULL;
+  handler->_urcRegistered = false;
+}
+
+unsigned long ModemClass::urcHandlersRejected()
+{
+  return _urcHandlersRejected;
+}
+
+void ModemClass::addPollHandler(ModemPollHandler* handler)
+{
+  if (handler->_pollRegistered) {
+    return;
+  }
+
+  handler->_pollNext = _pollHandlers;
+  handler->_pollRegistered = true;
+  _pollHandlers = handler;
+}
+
+void ModemClass::removePollHandler(ModemPollHandler* handler)
+{
+  if (!handler->_pollRegistered) {
+    return;
+  }
+
+  ModemPollHandler** link = &_pollHandlers;
+
+  while (*link != handler) {
+    link = &(*link)->_pollNext;
+  }
+
+  *link = handler->_pollNext;
+  handler->_pollNext = NULL;
+  handler->_pollRegistered = false;
+}
+
+void ModemClass::linkUrcHandler(ModemUrcHandler* handler)
+{
+  handler->_urcPrev = NULL;
+  handler->_urcNext = _urcHandlers;
+
+  if (_urcHandlers != NULL) {
+    _urcHandlers->_urcPrev = handler;
+  }
+
+  _urcHandlers = handler;
+  handler->_urcRegistered = true;
 }
 
 void ModemClass::setBaudRate(unsigned long baud)
@@ -361,4 +1106,101 @@ void ModemClass::setBaudRate(unsigned long baud)
   _baud = baud;
 }
 
+unsigned long ModemClass::negotiateBaudRate(unsigned long maxBaud, int probes)
+{
+  static const unsigned long rates[] = { 921600, 460800, 230400, 115200 };
+
+  String response;
+
+  _baudRateErrors = 0;
+
+  // reference answer at the current rate, which begin() verified
+  send("AT+CGMR");
+  if (waitForResponse(100, &response) != 1) {
+    return 0;
+  }
+
+  uint32_t reference = checksum(response);
+
+  for (unsigned int i = 0; i < (sizeof(rates) / sizeof(rates[0])); i++) {
+    if (rates[i] > maxBaud) {
+      continue;
+    }
+
+    if (rates[i] != _baud && !switchBaudRate(rates[i], 1000)) {
+      _baudRateErrors++;
+    } else {
+      _baud = rates[i];
+
+      int errors = 0;
+
+      // the echo has to come back intact too, or the response is never seen
+      for (int j = 0; j < probes; j++) {
+        send("AT+CGMR");
+        if (waitForResponse(100, &response) != 1 || checksum(response) != reference) {
+          errors++;
+        }
+      }
+
+      _baudRateErrors += errors;
+
+      if (errors == 0) {
+        return _baud;
+      }
+    }
+
+    // back to a rate that works before trying the next one
+    for (int j = 0; j < 3; j++) {
+      send("AT+IPR=115200");
+      delay(100);
+    }
+
+    _uart->end();
+    delay(100);
+    _uart->begin(115200);
+    _baud = 115200;
+
+    if (!autosense(2000)) {
+      return 0;
+    }
+  }
+
+  return 0;
+}
+
+unsigned long ModemClass::baudRate()
+{
+  return _baud;
+}
+
+unsigned long ModemClass::baudRateErrors()
+{
+  return _baudRateErrors;
+}
+
+int ModemClass::switchBaudRate(unsigned long baud, unsigned int timeout)
+{
+  sendf("AT+IPR=%ld", baud);
+  if (waitForResponse() != 1) {
+    return 0;
+  }
+
+  _uart->end();
+  delay(100);
+  _uart->begin(baud);
+
+  return autosense(timeout);
+}
+
+uint32_t ModemClass::checksum(const String& data)
+{
+  uint32_t sum = 0;
+
+  for (unsigned int i = 0; i < data.length(); i++) {
+    sum = (sum << 1 | sum >> 31) ^ (uint8_t)data[i];
+  }
+
+  return sum;
+}
+
 ModemClass MODEM(SerialGSM, 921600, GSM_RESETN, GSM_DTR);
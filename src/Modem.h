@@ -25,14 +25,62 @@
 
 #include <Arduino.h>
 
+#include "utility/ModemLine.h"
+#include "utility/ModemStats.h"
+#include "utility/ModemTrace.h"
+
 class ModemUrcHandler {
 public:
-  virtual void handleUrc(const String& urc) = 0;
+  ModemUrcHandler() : _urcNext(NULL), _urcPrev(NULL), _urcMask(0), _urcRegistered(false) {}
+  ModemUrcHandler(const ModemUrcHandler& other);
+  virtual ~ModemUrcHandler();
+  ModemUrcHandler& operator=(const ModemUrcHandler& other);
+
+  // called with every URC the handler registered for, the default passes a
+  // String copy on to handlers written for the deprecated String interface
+  virtual void handleUrc(const ModemLine& urc);
+  virtual void handleUrc(const String& urc) __attribute__((deprecated("override handleUrc(const ModemLine&) instead")));
+
+private:
+  friend class ModemClass;
+
+  // links in the modem's handler list, they belong to the object and are never copied
+  ModemUrcHandler* _urcNext;
+  ModemUrcHandler* _urcPrev;
+  uint32_t _urcMask;
+  bool _urcRegistered;
+};
+
+class ModemPollHandler {
+public:
+  ModemPollHandler() : _pollNext(NULL), _pollRegistered(false) {}
+  ModemPollHandler(const ModemPollHandler& /*other*/) : _pollNext(NULL), _pollRegistered(false) {}
+  virtual ~ModemPollHandler();
+  ModemPollHandler& operator=(const ModemPollHandler& /*other*/) { return *this; }
+
+  // called at the end of every MODEM.poll() while registered, it may queue
+  // background commands but must not send or wait for commands itself
+  virtual void handlePoll() = 0;
+
+private:
+  friend class ModemClass;
+
+  ModemPollHandler* _pollNext;
+  bool _pollRegistered;
+};
+
+typedef void (*ModemResponseCallback)(int status, void* context);
+typedef void (*ModemYieldCallback)(void* context);
+
+// one piece of a scatter/gather write
+struct ModemSegment {
+  const uint8_t* data;
+  size_t size;
 };
 
 class ModemClass {
 public:
-  ModemClass(Uart& uart, unsigned long baud, int resetPin, int dtrPin);
+  ModemClass(HardwareSerial& uart, unsigned long baud, int resetPin, int dtrPin);
 
   int begin(bool restart = true);
   void end();
@@ -49,6 +97,9 @@ public:
   int lowPowerMode();
   int noLowPowerMode();
 
+  int setFlowControl(bool enable);
+  int flowControl();
+
   size_t write(uint8_t c);
   size_t write(const uint8_t*, size_t);
 
@@ -57,34 +108,143 @@ public:
   void sendf(const char *fmt, ...);
 
   int waitForResponse(unsigned long timeout = 100, String* responseDataStorage = NULL);
-  int waitForPrompt(unsigned long timeout = 500);
+  int waitForResponse(unsigned long timeout, Print& responseDataSink);
+  int waitForResponseUntil(unsigned long deadline, String* responseDataStorage = NULL);
+  int waitForPrompt(unsigned long timeout = 500, char prompt = '>');
+  int waitForPromptUntil(unsigned long deadline, char prompt = '>');
   int ready();
   void poll();
   void setResponseDataStorage(String* responseDataStorage);
+  void setResponseDataSink(Print* responseDataSink);
+  void setBinaryDataStorage(uint8_t* data, size_t size);
+
+  int sendBackground(const char* command, unsigned long timeout, ModemResponseCallback callback, void* context,
+                      String* responseDataStorage = NULL, uint8_t* binaryData = NULL, size_t binaryDataSize = 0);
+
+  int setHexMode(bool enable);
+  int hexMode();
 
-  void addUrcHandler(ModemUrcHandler* handler);
+  int backgroundAvailable();
+  void cancelBackground(void* context);
+
+  void addUrcHandler(ModemUrcHandler* handler, const char* const* prefixes = NULL);
   void removeUrcHandler(ModemUrcHandler* handler);
+  unsigned long urcHandlersRejected();
+
+  void addPollHandler(ModemPollHandler* handler);
+  void removePollHandler(ModemPollHandler* handler);
 
   void setBaudRate(unsigned long baud);
+  unsigned long negotiateBaudRate(unsigned long maxBaud = 921600, int probes = 10);
+  unsigned long baudRate();
+  unsigned long baudRateErrors();
+
+  void setStats(ModemStats* stats);
+  void setTrace(ModemTrace* trace);
+
+  void setRxBuffer(uint8_t* buffer, size_t size);
+  void serviceRx();
+  unsigned long rxOverflows();
+
+  void setGuardTime(unsigned long guardTime);
+  unsigned long guardTimeWaited();
+
+  void setYieldCallback(ModemYieldCallback callback, void* context = NULL);
+  static unsigned long deadline(unsigned long timeout);
+  static bool expired(unsigned long deadline);
+  void idle(unsigned long duration = 0);
 
 private:
-  Uart* _uart;
+  bool handleLine();
+  void appendResponse();
+  int readRx();
+  int switchBaudRate(unsigned long baud, unsigned int timeout);
+  static uint32_t checksum(const String& data);
+  void dispatchUrc(const ModemLine& urc);
+  static uint32_t urcMask(const char* name, size_t length);
+  friend class ModemUrcHandler;
+  static void linkUrcHandler(ModemUrcHandler* handler);
+  void sendBackground();
+  void waitForBackground();
+  void drainBackground();
+  void dropBackground();
+  void completeBackground(int status);
+
+  HardwareSerial* _uart;
   unsigned long _baud;
+  unsigned long _baudRateErrors;
   int _resetPin;
   int _dtrPin;
   bool _lowPowerMode;
+  int _flowControl;
   unsigned long _lastResponseOrUrcMillis;
+  unsigned long _guardTime;
+  unsigned long _guardTimeWaited;
 
   enum {
     AT_COMMAND_IDLE,
     AT_RECEIVING_RESPONSE
   } _atCommandState;
   int _ready;
+
+  #define MODEM_LINE_BUFFER_SIZE 128 // long enough for every URC and result code
+  char _lineBuffer[MODEM_LINE_BUFFER_SIZE + 1];
+  size_t _lineLength;
+  bool _lineOverflow;
+  bool _lineIsEcho;
+
   String _buffer;
   String* _responseDataStorage;
-
-  #define MAX_URC_HANDLERS 10 // 7 sockets + GPRS + GSMLocation + GSMVoiceCall
-  static ModemUrcHandler* _urcHandlers[MAX_URC_HANDLERS];
+  Print* _responseDataSink;
+
+  uint8_t* _rxBuffer;
+  size_t _rxBufferSize;
+  volatile size_t _rxHead;
+  volatile size_t _rxTail;
+  volatile bool _rxServicing;
+  volatile unsigned long _rxOverflows;
+
+  ModemStats* _stats;
+  ModemTrace* _trace;
+
+  uint8_t* _binaryData;
+  size_t _binaryDataSize;
+  size_t _binaryDataIndex;
+  size_t _binaryDataRemaining;
+
+  int _hexMode;
+
+  #ifndef MODEM_BACKGROUND_QUEUE_SIZE
+  #define MODEM_BACKGROUND_QUEUE_SIZE 8 // a read ahead per socket + 1
+  #endif
+  struct {
+    String command;
+    unsigned long timeout;
+    unsigned long queued;
+    ModemResponseCallback callback;
+    void* context;
+    String* responseDataStorage;
+    uint8_t* binaryData;
+    size_t binaryDataSize;
+  } _backgroundQueue[MODEM_BACKGROUND_QUEUE_SIZE];
+
+  int _backgroundHead;
+  int _backgroundCount;
+  bool _backgroundSent;
+  unsigned long _backgroundStart;
+  int _backgroundReady;
+  bool _sending;
+  bool _abandoned;
+
+  ModemPollHandler* _pollHandlers;
+  bool _pollingHandlers;
+
+  ModemYieldCallback _yieldCallback;
+  void* _yieldContext;
+  bool _yielding;
+
+  static ModemUrcHandler* _urcHandlers;
+  static unsigned long _urcHandlersRejected;
   static Print* _debugPrint;
 };
 
@@ -0,0 +1,139 @@
+/*
+  This file is part of the MKRGSM library.
+  Copyright (C) 2018  Arduino AG (http://www.arduino.cc/)
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <Arduino.h>
+
+#include "GSMHex.h"
+
+static const char HEX_DIGITS[16] = {
+  '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'
+};
+
+// nibble value of every character, 0xff for characters that are not hex
+static const uint8_t HEX_VALUES[256] = {
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+};
+
+size_t GSMHex::encode(const uint8_t* data, size_t length, char* hex)
+{
+  size_t i = 0;
+
+  // four bytes per iteration, the Cortex-M0+ can't do unaligned word
+  // accesses so the bytes are still stored one by one
+  for (; (i + 4) <= length; i += 4) {
+    uint32_t w = ((uint32_t)data[i] << 24) | ((uint32_t)data[i + 1] << 16) | ((uint32_t)data[i + 2] << 8) | data[i + 3];
+
+    hex[0] = HEX_DIGITS[(w >> 28) & 0x0f];
+    hex[1] = HEX_DIGITS[(w >> 24) & 0x0f];
+    hex[2] = HEX_DIGITS[(w >> 20) & 0x0f];
+    hex[3] = HEX_DIGITS[(w >> 16) & 0x0f];
+    hex[4] = HEX_DIGITS[(w >> 12) & 0x0f];
+    hex[5] = HEX_DIGITS[(w >> 8) & 0x0f];
+    hex[6] = HEX_DIGITS[(w >> 4) & 0x0f];
+    hex[7] = HEX_DIGITS[w & 0x0f];
+    hex += 8;
+  }
+
+  for (; i < length; i++) {
+    *hex++ = HEX_DIGITS[data[i] >> 4];
+    *hex++ = HEX_DIGITS[data[i] & 0x0f];
+  }
+
+  return length * 2;
+}
+
+void GSMHex::encode(const uint8_t* data, size_t length, String& hex)
+{
+  char chunk[64 + 1];
+
+  while (length) {
+    size_t chunkSize = length;
+
+    if (chunkSize > (sizeof(chunk) - 1) / 2) {
+      chunkSize = (sizeof(chunk) - 1) / 2;
+    }
+
+    chunk[encode(data, chunkSize, chunk)] = '\0';
+    hex += chunk;
+
+    data += chunkSize;
+    length -= chunkSize;
+  }
+}
+
+int GSMHex::decode(const char* hex, size_t length, uint8_t* data)
+{
+  if (length % 2) {
+    return -1;
+  }
+
+  const uint8_t* in = (const uint8_t*)hex;
+  size_t size = length / 2;
+  size_t i = 0;
+  uint8_t invalid = 0;
+
+  // four bytes per iteration with a single validity check
+  for (; (i + 4) <= size; i += 4) {
+    uint8_t n[8];
+
+    for (int j = 0; j < 8; j++) {
+      n[j] = HEX_VALUES[in[j]];
+      invalid |= n[j];
+    }
+
+    if (invalid & 0xf0) {
+      return -1;
+    }
+
+    data[i] = (n[0] << 4) | n[1];
+    data[i + 1] = (n[2] << 4) | n[3];
+    data[i + 2] = (n[4] << 4) | n[5];
+    data[i + 3] = (n[6] << 4) | n[7];
+    in += 8;
+  }
+
+  for (; i < size; i++) {
+    uint8_t n1 = HEX_VALUES[in[0]];
+    uint8_t n2 = HEX_VALUES[in[1]];
+
+    if ((n1 | n2) & 0xf0) {
+      return -1;
+    }
+
+    data[i] = (n1 << 4) | n2;
+    in += 2;
+  }
+
+  return size;
+}
@@ -0,0 +1,55 @@
+/*
+  This file is part of the MKRGSM library.
+  Copyright (C) 2018  Arduino AG (http://www.arduino.cc/)
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _GSM_HEX_H_INCLUDED
+#define _GSM_HEX_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+class String;
+
+class GSMHex {
+
+public:
+  /** Encode bytes as upper case hex characters
+      @param data     Bytes to encode
+      @param length   Number of bytes
+      @param hex      Destination, must hold length * 2 characters (not NUL terminated)
+      @return number of characters written
+   */
+  static size_t encode(const uint8_t* data, size_t length, char* hex);
+
+  /** Append bytes to a String as upper case hex characters
+      @param data     Bytes to encode
+      @param length   Number of bytes
+      @param hex      String to append to
+   */
+  static void encode(const uint8_t* data, size_t length, String& hex);
+
+  /** Decode hex characters, upper or lower case
+      @param hex      Characters to decode
+      @param length   Number of characters, must be even
+      @param data     Destination, must hold length / 2 bytes
+      @return number of bytes decoded, -1 if the input is not valid hex
+   */
+  static int decode(const char* hex, size_t length, uint8_t* data);
+};
+
+#endif
@@ -22,89 +22,183 @@
 
 #include "Modem.h"
 
+#include "GSMHex.h"
 #include "GSMSocketBuffer.h"
 
-#define GSM_SOCKET_NUM_BUFFERS (sizeof(_buffers) / sizeof(_buffers[0]))
+static const char* const URC_PREFIXES[] = { "+UUSORD", "+UUSOCL", NULL };
+
+// Decodes the hex payload of a +USORD response while it is received:
+// <socket>,<length>,"<hex>" - straight into the caller's memory
+class GSMSocketReadSink : public Print {
+public:
+  GSMSocketReadSink(uint8_t* data, size_t maxSize) :
+    _data(data),
+    _maxSize(maxSize),
+    _size(0),
+    _hexLength(0),
+    _quoted(false),
+    _done(false),
+    _error(false)
+  {
+  }
+
+  virtual size_t write(uint8_t c)
+  {
+    if (_done || _error) {
+      return 1;
+    }
+
+    if (!_quoted) {
+      // skip the header up to the quote that opens the payload
+      _quoted = (c == '"');
+      return 1;
+    }
+
+    if (c == '"') {
+      flush();
+      _done = true;
+      return 1;
+    }
+
+    _hex[_hexLength++] = c;
+
+    if (_hexLength == sizeof(_hex)) {
+      flush();
+    }
+
+    return 1;
+  }
 
-#define GSM_SOCKET_BUFFER_SIZE 512
+  using Print::write;
 
-GSMSocketBufferClass::GSMSocketBufferClass()
+  size_t size() const { return _size; }
+  bool valid() const { return _done && !_error; }
+
+private:
+  void flush()
+  {
+    if (_size + _hexLength / 2 > _maxSize) {
+      _error = true;
+      return;
+    }
+
+    int decoded = GSMHex::decode(_hex, _hexLength, _data + _size);
+
+    _hexLength = 0;
+
+    if (decoded < 0) {
+      _error = true;
+      return;
+    }
+
+    _size += decoded;
+  }
+
+  uint8_t* _data;
+  size_t _maxSize;
+  size_t _size;
+  char _hex[64];
+  size_t _hexLength;
+  bool _quoted;
+  bool _done;
+  bool _error;
+};
+
+GSMSocketBufferClass::GSMSocketBufferClass() :
+  _bufferSize(GSM_SOCKET_BUFFER_SIZE)
 {
   memset(&_buffers, 0x00, sizeof(_buffers));
+  memset(&_storage, 0x00, sizeof(_storage));
+
+  MODEM.addUrcHandler(this, URC_PREFIXES);
 }
 
 GSMSocketBufferClass::~GSMSocketBufferClass()
 {
   for (unsigned int i = 0; i < GSM_SOCKET_NUM_BUFFERS; i++) {
     close(i);
+    free(_storage[i]);
   }
+
+  MODEM.removeUrcHandler(this);
 }
 
 void GSMSocketBufferClass::close(int socket)
 {
-  if (_buffers[socket].data) {
-    free(_buffers[socket].data);
-    _buffers[socket].data = _buffers[socket].head = NULL;
-    _buffers[socket].length = 0;
-  }
+  _buffers[socket].data = _buffers[socket].head = NULL;
+  _buffers[socket].length = 0;
+  _buffers[socket].pending = 0;
+  _buffers[socket].binary = false;
+  _buffers[socket].closed = false;
+  _buffers[socket].direct = false;
 }
 
-int GSMSocketBufferClass::available(int socket)
+bool GSMSocketBufferClass::allocate(int socket)
 {
-  if (_buffers[socket].length == 0) {
-    if (_buffers[socket].data == NULL) {
-      _buffers[socket].data = _buffers[socket].head = (uint8_t*)malloc(GSM_SOCKET_BUFFER_SIZE);
-      _buffers[socket].length = 0;
-    }
+  if (_buffers[socket].data != NULL) {
+    return true;
+  }
 
-    String response;
+  // allocated on first use and kept for the next connection on the
+  // socket, so sketches without sockets don't pay for the RAM and
+  // reconnects don't churn the heap
+  if (_storage[socket] == NULL) {
+    _storage[socket] = (uint8_t*)malloc(GSM_SOCKET_BUFFER_SIZE);
 
-    MODEM.sendf("AT+USORD=%d,%d", socket, GSM_SOCKET_BUFFER_SIZE);
-    int status = MODEM.waitForResponse(10000, &response);
-    if (status != 1) {
-      return -1;
+    if (_storage[socket] == NULL) {
+      return false;
     }
+  }
 
-    if (!response.startsWith("+USORD: ")) {
-      return 0;
-    }
+  _buffers[socket].data = _buffers[socket].head = _storage[socket];
+  _buffers[socket].length = 0;
 
-    int firstQuoteIndex = response.indexOf("\"");
+  return true;
+}
 
-    response.remove(0, firstQuoteIndex + 1);
-    response.remove(response.length() - 1);
+void GSMSocketBufferClass::setBufferSize(size_t size)
+{
+  if (size < 1) {
+    size = 1;
+  } else if (size > GSM_SOCKET_BUFFER_SIZE) {
+    size = GSM_SOCKET_BUFFER_SIZE;
+  }
 
-    size_t size = response.length() / 2;
+  _bufferSize = size;
+}
 
-    for (size_t i = 0; i < size; i++) {
-      byte n1 = response[i * 2];
-      byte n2 = response[i * 2 + 1];
+size_t GSMSocketBufferClass::bufferSize()
+{
+  return _bufferSize;
+}
 
-      if (n1 > '9') {
-        n1 = (n1 - 'A') + 10;
-      } else {
-        n1 = (n1 - '0');
-      }
+void GSMSocketBufferClass::setBinaryMode(int socket, bool binary)
+{
+  _buffers[socket].binary = binary;
+}
 
-      if (n2 > '9') {
-        n2 = (n2 - 'A') + 10;
-      } else {
-        n2 = (n2 - '0');
-      }
+int GSMSocketBufferClass::available(int socket)
+{
+  if (_buffers[socket].length > 0) {
+    return _buffers[socket].length;
+  }
 
-      _buffers[socket].data[i] = (n1 << 4) | n2;
-    }
+  // the modem announces data with +UUSORD, so there is no
+  // need to ask for it unless something is pending
+  if (_buffers[socket].pending > 0) {
+    return _buffers[socket].pending;
+  }
 
-    _buffers[socket].head = _buffers[socket].data;
-    _buffers[socket].length = size;
+  if (_buffers[socket].closed) {
+    return -1;
   }
 
-  return _buffers[socket].length;
+  return 0;
 }
 
 int GSMSocketBufferClass::peek(int socket)
 {
-  if (!available(socket)) {
+  if (fill(socket) <= 0) {
     return -1;
   }
 
@@ -113,9 +207,9 @@ int GSMSocketBufferClass::peek(int socket)
 
 int GSMSocketBufferClass::read(int socket, uint8_t* data, size_t length)
 {
-  int avail = available(socket);
+  int avail = fill(socket);
 
-  if (!avail) {
+  if (avail <= 0) {
     return 0;
   }
 
@@ -127,7 +221,318 @@ int GSMSocketBufferClass::read(int socket, uint8_t* data, size_t length)
   _buffers[socket].head += length;
   _buffers[socket].length -= length;
 
+  if (_buffers[socket].length == 0) {
+    prefetch(socket);
+  }
+
   return length;
 }
 
+int GSMSocketBufferClass::readDirect(int socket, uint8_t* data, size_t length, unsigned long timeout)
+{
+  unsigned long deadline = MODEM.deadline(timeout);
+  size_t count = 0;
+
+  // a read ahead that is on the way comes first, but the caller's timeout
+  // also covers waiting for it
+  while (_buffers[socket].prefetching) {
+    if (MODEM.expired(deadline)) {
+      return 0;
+    }
+
+    MODEM.poll();
+    MODEM.idle();
+  }
+
+  // data that was read ahead comes first
+  if (_buffers[socket].length > 0) {
+    count = _buffers[socket].length < (int)length ? _buffers[socket].length : length;
+
+    memcpy(data, _buffers[socket].head, count);
+    _buffers[socket].head += count;
+    _buffers[socket].length -= count;
+  }
+
+  // the rest goes straight from the modem into the caller's memory,
+  // don't let +UUSORD start a read ahead meanwhile
+  _buffers[socket].direct = true;
+
+  while (count < length) {
+    if (_buffers[socket].pending <= 0) {
+      if (_buffers[socket].closed || MODEM.expired(deadline)) {
+        break;
+      }
+
+      // wait for the modem to announce more, the sketch can do other work meanwhile
+      MODEM.poll();
+      MODEM.idle();
+      continue;
+    }
+
+    size_t chunkSize = length - count;
+
+    // the data doesn't go through the socket buffer, so only the modem limits the size
+    if (chunkSize > GSM_SOCKET_MAX_READ) {
+      chunkSize = GSM_SOCKET_MAX_READ;
+    }
+
+    int n = readModem(socket, data + count, chunkSize);
+
+    if (n < 0) {
+      break;
+    }
+
+    count += n;
+  }
+
+  _buffers[socket].direct = false;
+
+  prefetch(socket);
+
+  return count;
+}
+
+void GSMSocketBufferClass::handleUrc(const ModemLine& urc)
+{
+  if (urc.is("+UUSORD")) {
+    int socket = urc.fieldInt(0);
+
+    if (socket < 0 || socket >= GSM_SOCKET_NUM_BUFFERS) {
+      return;
+    }
+
+    if (urc.fieldUnsigned(1) == 4294967295UL) {
+      // socket closed by the peer
+      _buffers[socket].closed = true;
+      return;
+    }
+
+    _buffers[socket].pending = urc.fieldInt(1);
+
+    if (allocate(socket)) {
+      prefetch(socket);
+    }
+  } else if (urc.is("+UUSOCL")) {
+    int socket = urc.fieldInt(0);
+
+    if (socket >= 0 && socket < GSM_SOCKET_NUM_BUFFERS) {
+      _buffers[socket].pending = 0;
+      _buffers[socket].closed = true;
+    }
+  }
+}
+
+int GSMSocketBufferClass::fill(int socket)
+{
+  if (_buffers[socket].length > 0) {
+    return _buffers[socket].length;
+  }
+
+  if (_buffers[socket].prefetching) {
+    // a read ahead is on the way, wait for it instead of asking again,
+    // for no longer than the AT+USORD timeout
+    unsigned long deadline = MODEM.deadline(10000);
+
+    while (_buffers[socket].prefetching && !MODEM.expired(deadline)) {
+      MODEM.poll();
+      MODEM.idle();
+    }
+
+    if (_buffers[socket].length > 0) {
+      return _buffers[socket].length;
+    }
+
+    if (_buffers[socket].prefetching) {
+      return 0;
+    }
+  }
+
+  if (_buffers[socket].pending <= 0) {
+    return _buffers[socket].closed ? -1 : 0;
+  }
+
+  if (!allocate(socket)) {
+    return 0;
+  }
+
+  String response;
+
+  if (!MODEM.setHexMode(!_buffers[socket].binary)) {
+    return 0;
+  }
+
+  if (_buffers[socket].binary) {
+    // binary mode, the payload is read straight into the buffer
+    MODEM.setBinaryDataStorage(_buffers[socket].data, _bufferSize);
+  }
+
+  MODEM.sendf("AT+USORD=%d,%d", socket, _bufferSize);
+  int status = MODEM.waitForResponse(10000, &response);
+  if (status != 1) {
+    _buffers[socket].pending = 0;
+    _buffers[socket].closed = true;
+    return -1;
+  }
+
+  return store(socket, response);
+}
+
+int GSMSocketBufferClass::store(int socket, const String& response)
+{
+  // +USORD: <socket>,<length>,"<data>"
+  ModemLine line(response);
+
+  if (!line.is("+USORD")) {
+    _buffers[socket].pending = 0;
+    return 0;
+  }
+
+  size_t size;
+
+  if (_buffers[socket].binary) {
+    // the payload was already read into the buffer
+    size = line.fieldInt(1);
+
+    if (size > _bufferSize) {
+      size = _bufferSize;
+    }
+  } else {
+    size_t length;
+    const char* hex = line.field(2, &length);
+
+    if (length > _bufferSize * 2) {
+      return 0;
+    }
+
+    int decoded = GSMHex::decode(hex, length, _buffers[socket].data);
+    if (decoded < 0) {
+      return 0;
+    }
+
+    size = decoded;
+  }
+
+  _buffers[socket].head = _buffers[socket].data;
+  _buffers[socket].length = size;
+
+  updatePending(socket, size, _bufferSize);
+
+  return size;
+}
+
+int GSMSocketBufferClass::readModem(int socket, uint8_t* data, size_t length)
+{
+  String response;
+  GSMSocketReadSink sink(data, length);
+  size_t size;
+
+  if (!MODEM.setHexMode(!_buffers[socket].binary)) {
+    return -1;
+  }
+
+  if (_buffers[socket].binary) {
+    // binary mode, the payload is read straight into the caller's memory
+    MODEM.setBinaryDataStorage(data, length);
+  }
+
+  MODEM.sendf("AT+USORD=%d,%d", socket, length);
+
+  int status = _buffers[socket].binary ? MODEM.waitForResponse(10000, &response) : MODEM.waitForResponse(10000, sink);
+  if (status != 1) {
+    _buffers[socket].pending = 0;
+    _buffers[socket].closed = true;
+    return -1;
+  }
+
+  if (_buffers[socket].binary) {
+    ModemLine line(response);
+
+    if (!line.is("+USORD")) {
+      _buffers[socket].pending = 0;
+      return 0;
+    }
+
+    size = line.fieldInt(1);
+
+    if (size > length) {
+      size = length;
+    }
+  } else {
+    if (!sink.valid()) {
+      _buffers[socket].pending = 0;
+      return 0;
+    }
+
+    size = sink.size();
+  }
+
+  updatePending(socket, size, length);
+
+  return size;
+}
+
+void GSMSocketBufferClass::updatePending(int socket, size_t size, size_t requested)
+{
+  if (size < requested) {
+    // a short read drained the modem buffer
+    _buffers[socket].pending = 0;
+  } else if (_buffers[socket].pending > (int)size) {
+    _buffers[socket].pending -= size;
+  } else {
+    // a full read might have left more behind, check with the next read
+    _buffers[socket].pending = 1;
+  }
+}
+
+void GSMSocketBufferClass::prefetch(int socket)
+{
+  if (_buffers[socket].prefetching || _buffers[socket].direct || _buffers[socket].length > 0 || _buffers[socket].pending <= 0) {
+    return;
+  }
+
+  // switching the hex mode takes a command of its own,
+  // leave that to a regular read
+  if (MODEM.hexMode() != !_buffers[socket].binary) {
+    return;
+  }
+
+  char command[24];
+
+  sprintf(command, "AT+USORD=%d,%d", socket, (int)_bufferSize);
+
+  // background commands run one at a time and the response is
+  // consumed by the callback, so all sockets can share the storage
+  if (MODEM.sendBackground(command, 10000, prefetchResponseCallback, (void*)(intptr_t)socket, &_prefetchResponse,
+                            _buffers[socket].binary ? _buffers[socket].data : NULL, _bufferSize)) {
+    _buffers[socket].prefetching = true;
+  }
+}
+
+void GSMSocketBufferClass::handlePrefetchResponse(int socket, int status)
+{
+  _buffers[socket].prefetching = false;
+
+  if (status != 1) {
+    // the modem didn't run it (e.g. a regular command timed out), queueing
+    // it again would fail the same way, leave the data to a regular read
+    return;
+  }
+
+  if (_buffers[socket].data != NULL && _buffers[socket].length == 0) {
+    store(socket, _prefetchResponse);
+  }
+
+  // a slot in the queue is free again, serve sockets that didn't get one
+  for (int i = 0; i < GSM_SOCKET_NUM_BUFFERS; i++) {
+    if (_buffers[i].data != NULL) {
+      prefetch(i);
+    }
+  }
+}
+
+void GSMSocketBufferClass::prefetchResponseCallback(int status, void* context)
+{
+  GSMSocketBuffer.handlePrefetchResponse((int)(intptr_t)context, status);
+}
+
 GSMSocketBufferClass GSMSocketBuffer;
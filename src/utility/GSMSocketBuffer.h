@@ -23,25 +23,63 @@
 #include <stddef.h>
 #include <stdint.h>
 
-class GSMSocketBufferClass {
+#include "Modem.h"
+
+#define GSM_SOCKET_NUM_BUFFERS 7
+
+#define GSM_SOCKET_MAX_READ 1024 // largest read AT+USORD allows
+
+#ifndef GSM_SOCKET_BUFFER_SIZE
+#define GSM_SOCKET_BUFFER_SIZE 512 // up to GSM_SOCKET_MAX_READ, fewer AT+USORD round trips for more RAM
+#endif
+
+class GSMSocketBufferClass : public ModemUrcHandler {
 
-public:
 public:
   GSMSocketBufferClass();
   virtual ~GSMSocketBufferClass();
 
   void close(int socket);
 
+  void setBinaryMode(int socket, bool binary);
+
+  void setBufferSize(size_t size);
+  size_t bufferSize();
+
   int available(int socket);
   int peek(int socket);
   int read(int socket, uint8_t* data, size_t length);
+  int readDirect(int socket, uint8_t* data, size_t length, unsigned long timeout);
+
+  virtual void handleUrc(const ModemLine& urc);
 
 private:
+  bool allocate(int socket);
+  int fill(int socket);
+  int store(int socket, const String& response);
+  int readModem(int socket, uint8_t* data, size_t length);
+  void updatePending(int socket, size_t size, size_t requested);
+  void prefetch(int socket);
+  void handlePrefetchResponse(int socket, int status);
+
+  static void prefetchResponseCallback(int status, void* context);
+
   struct {
     uint8_t* data;
     uint8_t* head;
     int length;
-  } _buffers[7];
+    int pending;
+    bool binary;
+    bool closed;
+    bool prefetching;
+    bool direct;
+  } _buffers[GSM_SOCKET_NUM_BUFFERS];
+
+  uint8_t* _storage[GSM_SOCKET_NUM_BUFFERS];
+
+  size_t _bufferSize;
+
+  String _prefetchResponse;
 };
 
 extern GSMSocketBufferClass GSMSocketBuffer;
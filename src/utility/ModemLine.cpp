@@ -0,0 +1,180 @@
+/*
+  This file is part of the MKRGSM library.
+  Copyright (C) 2018  Arduino AG (http://www.arduino.cc/)
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ModemLine.h"
+
+ModemLine::ModemLine(const char* line, size_t length)
+{
+  tokenize(line, length);
+}
+
+ModemLine::ModemLine(const String& line)
+{
+  tokenize(line.c_str(), line.length());
+}
+
+void ModemLine::tokenize(const char* line, size_t length)
+{
+  // only the first line, without surrounding white space
+  const char* end = (const char*)memchr(line, '\n', length);
+
+  if (end != NULL) {
+    length = end - line;
+  }
+
+  while (length && (*line == ' ' || *line == '\r')) {
+    line++;
+    length--;
+  }
+
+  while (length && (line[length - 1] == ' ' || line[length - 1] == '\r')) {
+    length--;
+  }
+
+  _line = line;
+  _length = length;
+  _fields = 0;
+
+  const char* colon = (const char*)memchr(line, ':', length);
+
+  if (colon == NULL) {
+    _nameLength = (length > 255) ? 255 : length;
+    return;
+  }
+
+  _nameLength = ((colon - line) > 255) ? 255 : (colon - line);
+
+  size_t i = (colon - line) + 1;
+
+  while (i < length && line[i] == ' ') {
+    i++;
+  }
+
+  if (i == length) {
+    return;
+  }
+
+  while (i <= length && _fields < MODEM_LINE_MAX_FIELDS) {
+    size_t start = i;
+    size_t stop;
+
+    if (i < length && line[i] == '"') {
+      // quoted, commas inside don't split
+      start++;
+      stop = start;
+
+      while (stop < length && line[stop] != '"') {
+        stop++;
+      }
+
+      i = stop + 1;
+
+      while (i < length && line[i] != ',') {
+        i++;
+      }
+    } else {
+      while (i < length && line[i] != ',') {
+        i++;
+      }
+
+      stop = i;
+    }
+
+    _fieldStart[_fields] = start;
+    _fieldLength[_fields] = stop - start;
+    _fields++;
+
+    // skip the comma
+    i++;
+  }
+}
+
+bool ModemLine::is(const char* name) const
+{
+  size_t nameLength = strlen(name);
+
+  return (nameLength == _nameLength) && (memcmp(_line, name, nameLength) == 0);
+}
+
+const char* ModemLine::field(int index, size_t* length) const
+{
+  if (index < 0 || index >= _fields) {
+    if (length != NULL) {
+      *length = 0;
+    }
+
+    return NULL;
+  }
+
+  if (length != NULL) {
+    *length = _fieldLength[index];
+  }
+
+  return _line + _fieldStart[index];
+}
+
+long ModemLine::fieldInt(int index) const
+{
+  const char* start = field(index);
+
+  // conversion stops at the ',' or '"' after the field
+  return (start != NULL) ? strtol(start, NULL, 10) : 0;
+}
+
+unsigned long ModemLine::fieldUnsigned(int index) const
+{
+  const char* start = field(index);
+
+  return (start != NULL) ? strtoul(start, NULL, 10) : 0;
+}
+
+float ModemLine::fieldFloat(int index) const
+{
+  const char* start = field(index);
+
+  return (start != NULL) ? strtod(start, NULL) : 0;
+}
+
+bool ModemLine::fieldEquals(int index, const char* value) const
+{
+  size_t length;
+  const char* start = field(index, &length);
+
+  return (start != NULL) && (strlen(value) == length) && (memcmp(start, value, length) == 0);
+}
+
+String ModemLine::fieldString(int index) const
+{
+  size_t length;
+  const char* start = field(index, &length);
+  String result;
+
+  if (start != NULL) {
+    result.reserve(length);
+
+    for (size_t i = 0; i < length; i++) {
+      result += start[i];
+    }
+  }
+
+  return result;
+}
@@ -0,0 +1,88 @@
+/*
+  This file is part of the MKRGSM library.
+  Copyright (C) 2018  Arduino AG (http://www.arduino.cc/)
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _MODEM_LINE_H_INCLUDED
+#define _MODEM_LINE_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <Arduino.h>
+
+#define MODEM_LINE_MAX_FIELDS 16
+
+/** A URC or response line split into its name and comma separated fields,
+    the fields point into the original text, nothing is copied.
+    For "+UUSORD: 0,12" the name is "+UUSORD" and the fields are "0" and "12",
+    quotes around a field are not part of it.
+ */
+class ModemLine {
+
+public:
+  /** Tokenize the first line of a text, it must stay valid while the view is used
+      @param line     Text to tokenize
+      @param length   Number of characters
+   */
+  ModemLine(const char* line, size_t length);
+  ModemLine(const String& line);
+
+  /** Check the name of the line
+      @param name     Name to compare with, like "+UUSORD"
+      @return true if the line has that name
+   */
+  bool is(const char* name) const;
+  size_t nameLength() const { return _nameLength; }
+
+  /** @return the line without surrounding white space */
+  const char* data() const { return _line; }
+  size_t length() const { return _length; }
+
+  /** @return number of fields after the name */
+  int fields() const { return _fields; }
+
+  /** Access a field
+      @param index    Field index, starting at 0
+      @param length   Set to the length of the field
+      @return start of the field (not NUL terminated), NULL if there is no such field
+   */
+  const char* field(int index, size_t* length = NULL) const;
+
+  /** @return the field converted to a number, 0 if there is no such field */
+  long fieldInt(int index) const;
+  unsigned long fieldUnsigned(int index) const;
+  float fieldFloat(int index) const;
+
+  /** @return true if the field has exactly the given value */
+  bool fieldEquals(int index, const char* value) const;
+
+  /** @return a copy of the field */
+  String fieldString(int index) const;
+
+private:
+  void tokenize(const char* line, size_t length);
+
+  const char* _line;
+  uint16_t _length;
+  uint8_t _nameLength;
+  uint8_t _fields;
+  uint16_t _fieldStart[MODEM_LINE_MAX_FIELDS];
+  uint16_t _fieldLength[MODEM_LINE_MAX_FIELDS];
+};
+
+#endif
@@ -0,0 +1,174 @@
+/*
+  This file is part of the MKRGSM library.
+  Copyright (C) 2018  Arduino AG (http://www.arduino.cc/)
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <string.h>
+
+#include "ModemStats.h"
+
+ModemStats::ModemStats()
+{
+  reset();
+}
+
+void ModemStats::reset()
+{
+  memset(_commands, 0x00, sizeof(_commands));
+  _count = 0;
+  _current = NULL;
+  _start = 0;
+}
+
+int ModemStats::commands() const
+{
+  return _count;
+}
+
+const ModemCommandStats* ModemStats::command(int index) const
+{
+  if (index < 0 || index >= _count) {
+    return NULL;
+  }
+
+  return &_commands[index];
+}
+
+const ModemCommandStats* ModemStats::find(const char* prefix) const
+{
+  for (int i = 0; i < _count; i++) {
+    if (strcmp(_commands[i].prefix, prefix) == 0) {
+      return &_commands[i];
+    }
+  }
+
+  return NULL;
+}
+
+unsigned long ModemStats::percentile(const ModemCommandStats* stats, int percent)
+{
+  unsigned long wanted = (stats->count * percent + 99) / 100;
+  unsigned long seen = 0;
+
+  for (int i = 0; i < MODEM_STATS_BUCKETS; i++) {
+    seen += stats->histogram[i];
+
+    if (seen >= wanted) {
+      unsigned long bound = (1UL << i) - 1;
+
+      return (bound < stats->maxLatency) ? bound : stats->maxLatency;
+    }
+  }
+
+  return stats->maxLatency;
+}
+
+size_t ModemStats::printTo(Print& p) const
+{
+  size_t n = p.println("command,count,errors,timeouts,min_ms,avg_ms,max_ms,p99_ms,bytes_out,bytes_in");
+
+  for (int i = 0; i < _count; i++) {
+    const ModemCommandStats* stats = &_commands[i];
+    unsigned long completed = stats->count - stats->timeouts;
+    char line[128];
+
+    snprintf(line, sizeof(line), "%s,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu",
+              stats->prefix, stats->count, stats->errors, stats->timeouts,
+              stats->minLatency, completed ? (stats->totalLatency / completed) : 0,
+              stats->maxLatency, percentile(stats, 99), stats->bytesOut, stats->bytesIn);
+
+    n += p.println(line);
+  }
+
+  return n;
+}
+
+void ModemStats::commandSent(const char* command, size_t length)
+{
+  // the command without its parameters, like "AT+USORD"
+  size_t prefixLength = strcspn(command, "=?");
+
+  if (prefixLength > MODEM_STATS_PREFIX_LENGTH) {
+    prefixLength = MODEM_STATS_PREFIX_LENGTH;
+  }
+
+  _current = NULL;
+
+  for (int i = 0; i < _count; i++) {
+    if (strncmp(_commands[i].prefix, command, prefixLength) == 0 && _commands[i].prefix[prefixLength] == '\0') {
+      _current = &_commands[i];
+      break;
+    }
+  }
+
+  if (_current == NULL) {
+    if (_count < MODEM_STATS_COMMANDS - 1) {
+      _current = &_commands[_count++];
+
+      memcpy(_current->prefix, command, prefixLength);
+      _current->prefix[prefixLength] = '\0';
+    } else {
+      // the last entry is kept for the commands that don't fit, so
+      // the named entries never mix in other commands
+      _current = &_commands[MODEM_STATS_COMMANDS - 1];
+
+      if (_count < MODEM_STATS_COMMANDS) {
+        strcpy(_current->prefix, "*");
+        _count++;
+      }
+    }
+  }
+
+  _current->count++;
+  _current->bytesOut += length;
+  _start = millis();
+}
+
+void ModemStats::commandCompleted(int status)
+{
+  if (_current == NULL) {
+    return;
+  }
+
+  if (status == -1) {
+    _current->timeouts++;
+  } else {
+    unsigned long latency = millis() - _start;
+    int bucket = 0;
+
+    while (bucket < (MODEM_STATS_BUCKETS - 1) && (latency >> bucket) != 0) {
+      bucket++;
+    }
+
+    if (_current->count - _current->timeouts == 1 || latency < _current->minLatency) {
+      _current->minLatency = latency;
+    }
+
+    if (latency > _current->maxLatency) {
+      _current->maxLatency = latency;
+    }
+
+    _current->totalLatency += latency;
+    _current->histogram[bucket]++;
+
+    if (status != 1) {
+      _current->errors++;
+    }
+  }
+
+  _current = NULL;
+}
@@ -0,0 +1,97 @@
+/*
+  This file is part of the MKRGSM library.
+  Copyright (C) 2018  Arduino AG (http://www.arduino.cc/)
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _MODEM_STATS_H_INCLUDED
+#define _MODEM_STATS_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <Arduino.h>
+
+#define MODEM_STATS_COMMANDS 16
+#define MODEM_STATS_PREFIX_LENGTH 11
+#define MODEM_STATS_BUCKETS 16
+
+struct ModemCommandStats {
+  char prefix[MODEM_STATS_PREFIX_LENGTH + 1]; // like "AT+USORD", "*" in the last entry collects the commands that don't fit
+  unsigned long count;
+  unsigned long errors;                      // ERROR or NO CARRIER
+  unsigned long timeouts;
+  unsigned long minLatency;                  // ms from sending the command to its final result
+  unsigned long maxLatency;
+  unsigned long totalLatency;
+  unsigned long bytesOut;
+  unsigned long bytesIn;
+  uint16_t histogram[MODEM_STATS_BUCKETS];   // bucket n counts latencies below 2^n ms
+};
+
+/** Latency and error statistics per AT command, collected by the modem
+    once installed with MODEM.setStats(&stats)
+ */
+class ModemStats {
+
+public:
+  ModemStats();
+
+  /** Forget everything recorded so far */
+  void reset();
+
+  /** @return number of commands in the table */
+  int commands() const;
+
+  /** Access the statistics of a command
+      @param index    Table index, 0 to commands() - 1
+      @return statistics, NULL if there is no such entry
+   */
+  const ModemCommandStats* command(int index) const;
+
+  /** Find the statistics of a command
+      @param prefix   Command without parameters, like "AT+USOWR"
+      @return statistics, NULL if the command was not seen
+   */
+  const ModemCommandStats* find(const char* prefix) const;
+
+  /** Estimate a latency percentile from the histogram
+      @param stats    Statistics of the command
+      @param percent  Percentile, like 99
+      @return upper bound of the latency in ms
+   */
+  static unsigned long percentile(const ModemCommandStats* stats, int percent);
+
+  /** Print the table as CSV, one line per command
+      @param p        Where to print
+      @return number of characters printed
+   */
+  size_t printTo(Print& p) const;
+
+  // called by the modem
+  void commandSent(const char* command, size_t length);
+  void commandCompleted(int status);
+  void bytesSent(size_t length)     { if (_current != NULL) _current->bytesOut += length; }
+  void bytesReceived(size_t length) { if (_current != NULL) _current->bytesIn += length; }
+
+private:
+  ModemCommandStats _commands[MODEM_STATS_COMMANDS];
+  int _count;
+  ModemCommandStats* _current;
+  unsigned long _start;
+};
+
+#endif
@@ -0,0 +1,98 @@
+/*
+  This file is part of the MKRGSM library.
+  Copyright (C) 2018  Arduino AG (http://www.arduino.cc/)
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _MODEM_THREAD_H_INCLUDED
+#define _MODEM_THREAD_H_INCLUDED
+
+/** Protothreads for the ready() state machines: a function that talks to the
+    modem is written as one linear sequence of commands, yet returns to the
+    caller whenever it has to wait and resumes at the same place on the next call.
+
+    The position is kept in an int owned by the object (0 = start), locals do not
+    survive a wait, so anything needed after it must be a member. A switch
+    statement inside the thread can't span a wait and there can be only one wait
+    per source line. Several objects each with their own position progress
+    concurrently on the one modem, and a thread can run another one by waiting
+    until its ready() returns non zero.
+
+      int Foo::ready()
+      {
+        int ready = MODEM.ready();
+
+        if (ready == 0) {
+          return 0;
+        }
+
+        MODEM_THREAD_BEGIN(_position);
+
+        MODEM.send("AT+CMGF=1");
+        MODEM_THREAD_YIELD(_position, 0);   // resumes with the result in ready
+
+        if (ready > 1) {
+          MODEM_THREAD_EXIT(_position, 2);
+        }
+
+        MODEM_THREAD_END(_position);
+
+        return ready;
+      }
+ */
+
+#define MODEM_THREAD_START 0
+#define MODEM_THREAD_DONE -1
+
+/** Open the body of a thread, resuming at the last wait */
+#define MODEM_THREAD_BEGIN(position) \
+  switch (position) { \
+    case MODEM_THREAD_START:
+
+/** Return value, the next call continues after this statement */
+#define MODEM_THREAD_YIELD(position, value) \
+  do { \
+    (position) = __LINE__; \
+    return (value); \
+    case __LINE__:; \
+  } while (0)
+
+/** Return value until condition holds, checked again on every call */
+#define MODEM_THREAD_WAIT_UNTIL(position, condition, value) \
+  do { \
+    (position) = __LINE__; \
+    case __LINE__: \
+    if (!(condition)) { \
+      return (value); \
+    } \
+  } while (0)
+
+/** Finish the thread early, later calls skip to the code after MODEM_THREAD_END */
+#define MODEM_THREAD_EXIT(position, value) \
+  do { \
+    (position) = MODEM_THREAD_DONE; \
+    return (value); \
+  } while (0)
+
+/** Close the body of a thread, later calls skip straight past it */
+#define MODEM_THREAD_END(position) \
+    (position) = MODEM_THREAD_DONE; \
+    case MODEM_THREAD_DONE:; \
+  }
+
+#define MODEM_THREAD_FINISHED(position) ((position) == MODEM_THREAD_DONE)
+
+#endif
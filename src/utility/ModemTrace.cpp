@@ -0,0 +1,182 @@
+/*
+  This file is part of the MKRGSM library.
+  Copyright (C) 2018  Arduino AG (http://www.arduino.cc/)
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <string.h>
+
+#include "ModemTrace.h"
+
+// each record: type, stored length, original length (2 bytes), millis (4 bytes), payload
+#define RECORD_HEADER_SIZE 8
+
+static const char* const RECORD_TYPES[] = { "TX", "TXD", "RX", "URC", "TIMEOUT" };
+
+ModemTrace::ModemTrace(uint8_t* buffer, size_t size, size_t maxPayload) :
+  _buffer(buffer),
+  _size(size),
+  _maxPayload(maxPayload),
+  _failurePrint(NULL)
+{
+  if (_maxPayload > 255) {
+    _maxPayload = 255;
+  }
+
+  if (_size < RECORD_HEADER_SIZE + _maxPayload) {
+    _maxPayload = (_size > RECORD_HEADER_SIZE) ? (_size - RECORD_HEADER_SIZE) : 0;
+  }
+
+  clear();
+}
+
+void ModemTrace::clear()
+{
+  _head = 0;
+  _used = 0;
+  _dropped = 0;
+}
+
+void ModemTrace::dumpOnFailure(Print* p)
+{
+  _failurePrint = p;
+}
+
+unsigned long ModemTrace::dropped() const
+{
+  return _dropped;
+}
+
+void ModemTrace::record(uint8_t type, const char* data, size_t length)
+{
+  if (_size < RECORD_HEADER_SIZE) {
+    return;
+  }
+
+  // line endings only take space
+  while (length && (data[length - 1] == '\r' || data[length - 1] == '\n')) {
+    length--;
+  }
+
+  if (length == 0 && type != TIMEOUT) {
+    return;
+  }
+
+  size_t stored = (length > _maxPayload) ? _maxPayload : length;
+  unsigned long now = millis();
+  uint8_t header[RECORD_HEADER_SIZE];
+
+  header[0] = type;
+  header[1] = stored;
+  header[2] = length >> 8;
+  header[3] = length;
+  header[4] = now >> 24;
+  header[5] = now >> 16;
+  header[6] = now >> 8;
+  header[7] = now;
+
+  while (_used + RECORD_HEADER_SIZE + stored > _size) {
+    dropOldest();
+  }
+
+  put(header, sizeof(header));
+  put((const uint8_t*)data, stored);
+
+  if (type == TIMEOUT && _failurePrint != NULL) {
+    printTo(*_failurePrint);
+  }
+}
+
+size_t ModemTrace::printTo(Print& p) const
+{
+  size_t n = 0;
+  size_t offset = 0;
+
+  while (offset < _used) {
+    uint8_t header[RECORD_HEADER_SIZE];
+    uint8_t payload[255];
+
+    get(offset, header, sizeof(header));
+    get(offset + RECORD_HEADER_SIZE, payload, header[1]);
+
+    unsigned long time = ((unsigned long)header[4] << 24) | ((unsigned long)header[5] << 16) | (header[6] << 8) | header[7];
+    size_t length = (header[2] << 8) | header[3];
+
+    n += p.print(time);
+    n += p.print(' ');
+    n += p.print(RECORD_TYPES[header[0] < 5 ? header[0] : 0]);
+
+    if (length) {
+      n += p.print(' ');
+    }
+
+    for (int i = 0; i < header[1]; i++) {
+      char c = payload[i];
+
+      if (c >= ' ' && c <= '~') {
+        n += p.print(c);
+      } else {
+        char escaped[5];
+
+        snprintf(escaped, sizeof(escaped), "\\x%02x", (uint8_t)c);
+        n += p.print(escaped);
+      }
+    }
+
+    if (length > header[1]) {
+      n += p.print("... (");
+      n += p.print(length);
+      n += p.print(" bytes)");
+    }
+
+    n += p.println();
+
+    offset += RECORD_HEADER_SIZE + header[1];
+  }
+
+  return n;
+}
+
+void ModemTrace::put(const uint8_t* data, size_t length)
+{
+  for (size_t i = 0; i < length; i++) {
+    _buffer[_head] = data[i];
+    _head = (_head + 1) % _size;
+  }
+
+  _used += length;
+}
+
+void ModemTrace::get(size_t offset, uint8_t* data, size_t length) const
+{
+  // offset counts from the oldest record
+  size_t index = (_head + _size - _used + offset) % _size;
+
+  for (size_t i = 0; i < length; i++) {
+    data[i] = _buffer[index];
+    index = (index + 1) % _size;
+  }
+}
+
+void ModemTrace::dropOldest()
+{
+  uint8_t header[2];
+
+  get(0, header, sizeof(header));
+
+  _used -= RECORD_HEADER_SIZE + header[1];
+  _dropped++;
+}
@@ -0,0 +1,83 @@
+/*
+  This file is part of the MKRGSM library.
+  Copyright (C) 2018  Arduino AG (http://www.arduino.cc/)
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef _MODEM_TRACE_H_INCLUDED
+#define _MODEM_TRACE_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <Arduino.h>
+
+/** Ring of timestamped modem traffic records kept in RAM, installed with
+    MODEM.setTrace(&trace). Once the ring is full the oldest records are
+    dropped, payloads are truncated to keep records small.
+ */
+class ModemTrace {
+
+public:
+  enum {
+    TX,       // command sent
+    TX_DATA,  // raw data written after a prompt
+    RX,       // response line
+    URC,      // unsolicited result code
+    TIMEOUT   // no final result code in time
+  };
+
+  /** @param buffer      Storage for the ring
+      @param size        Size of the storage in bytes
+      @param maxPayload  Bytes kept of each record's payload
+   */
+  ModemTrace(uint8_t* buffer, size_t size, size_t maxPayload = 32);
+
+  /** Drop all records */
+  void clear();
+
+  /** Print the ring every time a timeout is recorded
+      @param p        Where to print, NULL to stop
+   */
+  void dumpOnFailure(Print* p);
+
+  /** Print the records, oldest first, one line each: "<ms> <type> <payload>"
+      @param p        Where to print
+      @return number of characters printed
+   */
+  size_t printTo(Print& p) const;
+
+  /** @return number of records dropped to make room since the last clear() */
+  unsigned long dropped() const;
+
+  // called by the modem
+  void record(uint8_t type, const char* data, size_t length);
+
+private:
+  void put(const uint8_t* data, size_t length);
+  void get(size_t offset, uint8_t* data, size_t length) const;
+  void dropOldest();
+
+  uint8_t* _buffer;
+  size_t _size;
+  size_t _maxPayload;
+  size_t _head;
+  size_t _used;
+  unsigned long _dropped;
+  Print* _failurePrint;
+};
+
+#endif